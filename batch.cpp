@@ -0,0 +1,281 @@
+/**
+ * @file    batch.cpp
+ *
+ * Headless front end for the filters in filter.h. Runs the selected filter,
+ * or a chain of them (see filtergraph.h), over a list of images (or every
+ * image in a directory) without ever creating a window. Several images are
+ * processed at once, and every filter also splits its own image across the
+ * shared thread pool.
+ *
+ *   projects_2d_batch -f blur --radius 5 -o out/ photos/ extra.png
+ *   projects_2d_batch -f gray,blur,edge --radius 2 -o edges/ photos/
+ *   projects_2d_batch -f blur --radius 20 --tiled -j 1 scans/
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QImageReader>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include "edge.h"
+#include "filtergraph.h"
+#include "imageio.h"
+#include "median.h"
+#include "parallel.h"
+#include "settings.h"
+#include "tiledimage.h"
+
+static const QStringList imageFilters = {"*.png", "*.jpg", "*.jpeg", "*.bmp"};
+
+// largest --radius; the kernels and windows grow with it, so beyond this it is a typo
+static constexpr int MAX_RADIUS = 1000;
+
+/**
+ * @brief Maps a filter name from the command line to its FilterType
+ * @return -1 if the name is unknown
+ */
+static int parseFilterType(const QString &name) {
+    if (name == "edge") return FILTER_EDGE_DETECT;
+    if (name == "blur") return FILTER_BLUR;
+    if (name == "scale") return FILTER_SCALE;
+    if (name == "median") return FILTER_MEDIAN;
+    if (name == "bilateral") return FILTER_BILATERAL;
+    if (name == "rotate") return FILTER_ROTATION;
+    if (name == "chromatic") return FILTER_CHROMATIC;
+    if (name == "tonemap") return FILTER_MAPPING;
+    return -1;
+}
+
+/**
+ * @brief Appends the stages of a comma separated --filter chain to `graph`,
+ * e.g. "gray,blur,edge". Returns false if a name is unknown
+ */
+static bool parseFilterChain(const QString &chain, const Settings &settings, FilterGraph &graph) {
+    for (const QString &name : chain.split(',', Qt::SkipEmptyParts)) {
+        if (name == "gray") {
+            graph.gray();
+        } else if (name == "invert") {
+            graph.invert();
+        } else if (!graph.add(parseFilterType(name), settings)) {
+            return false;
+        }
+    }
+    return !graph.empty();
+}
+
+/**
+ * @brief Maps an --edge-magnitude name to EdgeMagnitude, -1 if unknown
+ */
+static int parseEdgeMagnitude(const QString &name) {
+    if (name == "exact") return EDGE_MAGNITUDE_EXACT;
+    if (name == "l1") return EDGE_MAGNITUDE_L1;
+    if (name == "fast") return EDGE_MAGNITUDE_ALPHA_MAX_BETA_MIN;
+    return -1;
+}
+
+/**
+ * @brief Expands directories in `inputs` to the images they contain
+ */
+static QStringList collectImages(const QStringList &inputs) {
+    QStringList files;
+    for (const QString &input : inputs) {
+        QFileInfo info(input);
+        if (info.isDir()) {
+            QDir dir(input);
+            for (const QString &name : dir.entryList(imageFilters, QDir::Files, QDir::Name)) {
+                files << dir.filePath(name);
+            }
+        } else {
+            files << input;
+        }
+    }
+    return files;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("projects_2d_batch");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Apply a Canvas2D filter to many images without the GUI.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("inputs", "Image files or directories of images.", "<inputs...>");
+
+    QCommandLineOption filterOption({"f", "filter"}, "Filter to apply: edge, blur, scale, median, bilateral, rotate, chromatic, "
+                                                     "tonemap, gray, invert, or a comma separated chain of them run in order (e.g. gray,blur,edge).", "names");
+    QCommandLineOption outputOption({"o", "output"}, "Output directory (default: filtered).", "dir", "filtered");
+    QCommandLineOption jobsOption({"j", "jobs"}, "Number of images processed in parallel (default: all cores).", "n");
+    QCommandLineOption threadsOption({"t", "threads"}, "Threads shared by the filters (default: all cores).", "n", "0");
+    QCommandLineOption radiusOption("radius", "Blur, median or bilateral radius.", "r");
+    QCommandLineOption sensitivityOption("sensitivity", "Edge detect sensitivity (default: 0.5).", "s", "0.5");
+    QCommandLineOption edgeMagnitudeOption("edge-magnitude", "Edge magnitude: exact, l1 or fast (default: exact).", "mode", "exact");
+    QCommandLineOption scaleXOption("scale-x", "Horizontal scale factor (default: 2).", "x", "2");
+    QCommandLineOption scaleYOption("scale-y", "Vertical scale factor (default: 2).", "y", "2");
+    QCommandLineOption bilateralGridOption("bilateral-grid", "Use the bilateral grid approximation.");
+    QCommandLineOption lambdasOption("lambdas", "Chromatic aberration lambdas for red, green and blue "
+                                                "(default: 1e-7,5e-7,1e-6).", "r,g,b", "1e-7,5e-7,1e-6");
+    QCommandLineOption gammaOption("gamma", "Tone map through t^gamma instead of linearly.", "gamma");
+    QCommandLineOption clipOption("clip", "Percent of values tone mapping clips at either end (default: 0).", "percent", "0");
+    QCommandLineOption angleOption("angle", "Rotation angle in degrees, counterclockwise (default: 90).", "degrees", "90");
+    QCommandLineOption tiledOption("tiled", "Keep images in memory-mapped scratch files and filter them tile by tile, "
+                                            "for images larger than RAM (best with -j 1).");
+    QCommandLineOption scratchOption("scratch-dir", "Directory for the --tiled scratch files (default: system temp).", "dir");
+    parser.addOptions({filterOption, outputOption, jobsOption, threadsOption, radiusOption,
+                       sensitivityOption, edgeMagnitudeOption, scaleXOption, scaleYOption, bilateralGridOption,
+                       angleOption, lambdasOption, gammaOption, clipOption, tiledOption, scratchOption});
+    parser.process(app);
+
+    Settings filterSettings = {};
+    bool radius_ok = true;
+    int radius = parser.isSet(radiusOption) ? parser.value(radiusOption).toInt(&radius_ok) : 1;
+    if (!radius_ok || radius < 0 || radius > MAX_RADIUS) {
+        std::cerr << "--radius must be a whole number from 0 to " << MAX_RADIUS << std::endl;
+        return 1;
+    }
+    filterSettings.blurRadius = parser.isSet(radiusOption) ? radius : 10;
+    filterSettings.medianRadius = radius;
+    if (parser.value(filterOption).split(',').contains("median") && radius > MAX_MEDIAN_RADIUS) {
+        std::cerr << "--radius for median must be at most " << MAX_MEDIAN_RADIUS << std::endl;
+        return 1;
+    }
+    filterSettings.bilateralRadius = radius;
+    filterSettings.bilateralGrid = parser.isSet(bilateralGridOption);
+    bool sensitivity_ok;
+    filterSettings.edgeDetectSensitivity = parser.value(sensitivityOption).toFloat(&sensitivity_ok);
+    // the integer magnitudes scale by it in 1/256 steps, so it has to stay small and positive
+    if (!sensitivity_ok || !(filterSettings.edgeDetectSensitivity >= 0) || !(filterSettings.edgeDetectSensitivity <= 100)) {
+        std::cerr << "--sensitivity must be from 0 to 100" << std::endl;
+        return 1;
+    }
+    filterSettings.edgeMagnitude = parseEdgeMagnitude(parser.value(edgeMagnitudeOption));
+    if (filterSettings.edgeMagnitude < 0) {
+        std::cerr << "Unknown edge magnitude, see --help" << std::endl;
+        return 1;
+    }
+    bool ok_x, ok_y;
+    filterSettings.scaleX = parser.value(scaleXOption).toFloat(&ok_x);
+    filterSettings.scaleY = parser.value(scaleYOption).toFloat(&ok_y);
+    // the resampling kernels widen with 1 / scale, so zero or negative has no support
+    if (!ok_x || !ok_y || !(filterSettings.scaleX > 0) || !(filterSettings.scaleY > 0)
+        || !std::isfinite(filterSettings.scaleX) || !std::isfinite(filterSettings.scaleY)) {
+        std::cerr << "--scale-x and --scale-y must be greater than 0" << std::endl;
+        return 1;
+    }
+    filterSettings.rotationAngle = parser.value(angleOption).toFloat();
+    filterSettings.nonLinearMap = parser.isSet(gammaOption);
+    if (filterSettings.nonLinearMap) {
+        bool gamma_ok;
+        filterSettings.gamma = parser.value(gammaOption).toFloat(&gamma_ok);
+        if (!gamma_ok || !(filterSettings.gamma > 0) || !std::isfinite(filterSettings.gamma)) {
+            std::cerr << "--gamma must be greater than 0" << std::endl;
+            return 1;
+        }
+    }
+    bool clip_ok;
+    filterSettings.toneClip = parser.value(clipOption).toFloat(&clip_ok);
+    if (!clip_ok || !(filterSettings.toneClip >= 0) || !(filterSettings.toneClip < 50)) {
+        std::cerr << "--clip must be at least 0 and below 50" << std::endl;
+        return 1;
+    }
+    QStringList lambdas = parser.value(lambdasOption).split(',');
+    if (lambdas.size() != 3) {
+        std::cerr << "--lambdas takes three comma separated values, see --help" << std::endl;
+        return 1;
+    }
+    filterSettings.lambda_1 = lambdas[0].toFloat();
+    filterSettings.lambda_2 = lambdas[1].toFloat();
+    filterSettings.lambda_3 = lambdas[2].toFloat();
+
+    FilterGraph filters;
+    if (!parseFilterChain(parser.value(filterOption), filterSettings, filters)) {
+        std::cerr << "Unknown or missing filter, see --help" << std::endl;
+        return 1;
+    }
+
+    QStringList files = collectImages(parser.positionalArguments());
+    if (files.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    QDir outputDir(parser.value(outputOption));
+    if (!outputDir.mkpath(".")) {
+        std::cerr << "Cannot create output directory " << outputDir.path().toStdString() << std::endl;
+        return 1;
+    }
+
+    // outputs keep only the file name, so inputs of the same name from two
+    // directories would overwrite each other, possibly from two workers at once
+    QStringList outputs;
+    QHash<QString, QString> sources;
+    for (const QString &file : files) {
+        QString output = outputDir.filePath(QFileInfo(file).fileName());
+        if (sources.contains(output)) {
+            std::cerr << sources[output].toStdString() << " and " << file.toStdString()
+                      << " would both be written to " << output.toStdString() << std::endl;
+            return 1;
+        }
+        sources.insert(output, file);
+        outputs << output;
+    }
+
+    setThreadCount(parser.value(threadsOption).toInt());
+
+    bool tiled = parser.isSet(tiledOption);
+    QString scratchDir = parser.value(scratchOption);
+    if (tiled) {
+        // the whole point is images past Qt's default 256 MB decode limit
+        QImageReader::setAllocationLimit(0);
+    }
+
+    int jobs = parser.isSet(jobsOption) ? parser.value(jobsOption).toInt()
+                                        : std::thread::hardware_concurrency();
+    jobs = std::max(1, std::min<int>(jobs, files.size()));
+
+    // workers pull the next image off a shared counter, so slow images
+    // do not hold up the rest of the batch
+    std::atomic<int> next = 0;
+    std::atomic<int> failures = 0;
+    std::mutex log_mutex;
+    auto worker = [&]() {
+        // every worker runs its own copy, so each keeps its own scratch buffer
+        FilterGraph graph = filters;
+        for (int i = next++; i < files.size(); i = next++) {
+            const QString &file = files[i];
+            const QString &output = outputs[i];
+            bool ok;
+            if (tiled) {
+                TiledImage image(scratchDir);
+                ok = image.load(file) && graph.runTiled(image) && image.save(output);
+            } else {
+                std::vector<RGBA> data;
+                int width, height;
+                ok = loadImage(file, data, width, height);
+                if (ok) {
+                    graph.run(data, width, height);
+                }
+                ok = ok && saveImage(output, data, width, height);
+            }
+            if (!ok) {
+                failures++;
+            }
+            std::lock_guard<std::mutex> lock(log_mutex);
+            std::cout << (ok ? "done   " : "FAILED ") << file.toStdString() << std::endl;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < jobs; i++) {
+        threads.emplace_back(worker);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,403 @@
+/**
+ * @file    bench.cpp
+ *
+ * Benchmarks for the filter and brush hot paths. Every case is timed on
+ * synthetic images from 500x500 up to 8K and reported as megapixels per
+ * second, together with the peak resident memory reached while it ran.
+ * Results are printed as a table and written as JSON so runs can be
+ * compared against each other.
+ *
+ *   canvas_bench --sizes 500x500,3840x2160 --cases blur,edge --json out.json
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include "brush.h"
+#include "edge.h"
+#include "filter.h"
+#include "filtergraph.h"
+#include "imageio.h"
+#include "median.h"
+#include "parallel.h"
+#include "settings.h"
+#include "stroke.h"
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+struct BenchSize {
+    int width;
+    int height;
+};
+
+struct BenchResult {
+    std::string name;
+    int width;
+    int height;
+    int threads;
+    int iterations;
+    double seconds;           // mean wall time of one iteration
+    double mpix_per_second;
+    long peak_memory_kb;
+};
+
+// the timed part of a case; returns the number of pixels it touched
+using BenchRun = std::function<double()>;
+
+// one case: `prepare` builds fresh input outside the timed region and
+// returns the work to be measured
+struct BenchCase {
+    std::string name;
+    bool scales_with_threads;
+    std::function<BenchRun(const BenchSize &)> prepare;
+};
+
+// ------ MEMORY ------
+
+/**
+ * @brief Resets the peak resident set size, where the OS allows it, so the
+ * next reading only covers the following case
+ */
+void resetPeakMemory() {
+#if defined(__linux__)
+    if (FILE *f = std::fopen("/proc/self/clear_refs", "w")) {
+        std::fputs("5", f);
+        std::fclose(f);
+    }
+#endif
+}
+
+/**
+ * @brief Returns the peak resident set size in kilobytes, 0 if unknown
+ */
+long peakMemoryKB() {
+#if defined(__linux__)
+    if (FILE *f = std::fopen("/proc/self/status", "r")) {
+        char line[256];
+        long kb = 0;
+        while (std::fgets(line, sizeof(line), f)) {
+            if (std::sscanf(line, "VmHWM: %ld kB", &kb) == 1) {
+                break;
+            }
+        }
+        std::fclose(f);
+        return kb;
+    }
+#endif
+#if defined(__linux__) || defined(__APPLE__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+// ------ INPUTS ------
+
+/**
+ * @brief Deterministic test image: smooth gradients, a few hard edges and
+ * some noise, so that median/bilateral/edge detect do real work
+ */
+std::vector<RGBA> makeTestImage(int width, int height) {
+    std::vector<RGBA> data(width * height);
+    std::uint32_t state = 12345;
+    for (int row = 0; row < height; row++) {
+        for (int col = 0; col < width; col++) {
+            state = state * 1664525u + 1013904223u;
+            int noise = (state >> 24) % 32;
+            bool block = ((row / 64) + (col / 64)) % 2;
+            data[row * width + col] = RGBA{
+                std::uint8_t((col * 255 / width + noise) % 256),
+                std::uint8_t((row * 255 / height + noise) % 256),
+                std::uint8_t(block ? 200 : 40 + noise),
+                255};
+        }
+    }
+    return data;
+}
+
+Settings benchSettings() {
+    Settings s = {};
+    s.brushColor = RGBA{200, 30, 30, 180};
+    s.brushDensity = 50;
+    s.smudgeStrength = 1.0f;
+    s.edgeDetectSensitivity = 0.5f;
+    return s;
+}
+
+// ------ CASES ------
+
+BenchCase filterCase(std::string name, std::function<void(Settings &)> configure) {
+    return {name, true, [configure](const BenchSize &size) -> BenchRun {
+        Settings s = benchSettings();
+        configure(s);
+        auto data = std::make_shared<std::vector<RGBA>>(makeTestImage(size.width, size.height));
+        return [=] {
+            int width = size.width;
+            int height = size.height;
+            applyFilter(*data, width, height, s);
+            return double(size.width) * size.height;
+        };
+    }};
+}
+
+BenchCase chainCase(std::string name, std::function<void(FilterGraph &)> build) {
+    return {name, true, [build](const BenchSize &size) -> BenchRun {
+        auto graph = std::make_shared<FilterGraph>();
+        build(*graph);
+        auto data = std::make_shared<std::vector<RGBA>>(makeTestImage(size.width, size.height));
+        return [=] {
+            int width = size.width;
+            int height = size.height;
+            graph->run(*data, width, height);
+            return double(size.width) * size.height;
+        };
+    }};
+}
+
+BenchCase brushCase(std::string name, int brushType, int radius, bool fixAlpha = false) {
+    return {name, false, [brushType, radius, fixAlpha](const BenchSize &size) -> BenchRun {
+        Settings s = benchSettings();
+        s.brushType = brushType;
+        s.brushRadius = radius;
+        s.fixAlphaBlending = fixAlpha;
+        auto data = std::make_shared<std::vector<RGBA>>(makeTestImage(size.width, size.height));
+        auto brush = createBrushMask(brushType, radius);
+        auto alphaStroke = std::make_shared<AlphaStroke>();
+        auto smudge = std::make_shared<SmudgeBuffer>();
+        return [=] {
+            if (fixAlpha) {
+                alphaStroke->begin(size.width, size.height);
+            }
+            RGBA white = RGBA{255, 255, 255, 255};
+
+            // a diagonal stroke, spaced the same way the canvas spaces it
+            int end = std::min(size.width, size.height) - 1;
+            Stroke stroke;
+            stroke.begin(0, 0, Stroke::spacingFor(radius));
+            stroke.moveTo(end, end);
+            if (brushType == BRUSH_SMUDGE) {
+                smudge->begin(*data, size.width, size.height, radius, 0, 0);
+            }
+            std::uint64_t seed = 0;
+            std::size_t stamps = stroke.rasterize(stroke.pending(), [&](int x, int y) {
+                drawStamp(*data, size.width, size.height, *brush, smudge->colors(), s, white, x - radius, y - radius,
+                          fixAlpha ? alphaStroke.get() : nullptr, seed++);
+                if (brushType == BRUSH_SMUDGE) {
+                    smudge->pickUp(*data, size.width, size.height, x, y, s.smudgeStrength);
+                }
+            });
+            if (fixAlpha) {
+                alphaStroke->end();
+            }
+            return double(2 * radius + 1) * (2 * radius + 1) * stamps;
+        };
+    }};
+}
+
+std::vector<BenchCase> allCases(int medianRadius, int bilateralRadius, int brushRadius) {
+    std::vector<BenchCase> cases = {
+        filterCase("blur_r1", [](Settings &s) { s.filterType = FILTER_BLUR; s.blurRadius = 1; }),
+        filterCase("blur_r10", [](Settings &s) { s.filterType = FILTER_BLUR; s.blurRadius = 10; }),
+        filterCase("blur_r100", [](Settings &s) { s.filterType = FILTER_BLUR; s.blurRadius = 100; }),
+        filterCase("edge", [](Settings &s) { s.filterType = FILTER_EDGE_DETECT; }),
+        filterCase("edge_fast", [](Settings &s) { s.filterType = FILTER_EDGE_DETECT; s.edgeMagnitude = EDGE_MAGNITUDE_ALPHA_MAX_BETA_MIN; }),
+        filterCase("scale_up", [](Settings &s) { s.filterType = FILTER_SCALE; s.scaleX = 2; s.scaleY = 2; }),
+        filterCase("scale_down", [](Settings &s) { s.filterType = FILTER_SCALE; s.scaleX = 0.5; s.scaleY = 0.5; }),
+        filterCase("scale_thumbnail", [](Settings &s) { s.filterType = FILTER_SCALE; s.scaleX = 0.1; s.scaleY = 0.1; }),
+        filterCase("median", [=](Settings &s) { s.filterType = FILTER_MEDIAN; s.medianRadius = medianRadius; }),
+        filterCase("bilateral", [=](Settings &s) { s.filterType = FILTER_BILATERAL; s.bilateralRadius = bilateralRadius; }),
+        filterCase("bilateral_grid", [](Settings &s) { s.filterType = FILTER_BILATERAL; s.bilateralGrid = true; }),
+        chainCase("chain_gray_blur_edge", [](FilterGraph &g) { g.gray().blur(10).gray().edges(0.5f, EDGE_MAGNITUDE_EXACT); }),
+        chainCase("chain_scale_blur", [](FilterGraph &g) { g.scale(0.5f, 0.5f).blur(10); }),
+
+        brushCase("brush_constant", BRUSH_CONSTANT, brushRadius),
+        brushCase("brush_constant_fixalpha", BRUSH_CONSTANT, brushRadius, true),
+        brushCase("brush_linear", BRUSH_LINEAR, brushRadius),
+        brushCase("brush_quadratic", BRUSH_QUADRATIC, brushRadius),
+        brushCase("brush_smudge", BRUSH_SMUDGE, brushRadius),
+        brushCase("brush_spray", BRUSH_SPRAY, brushRadius),
+        brushCase("brush_eraser", BRUSH_ERASER, brushRadius),
+
+        {"fill_bucket", false, [](const BenchSize &size) -> BenchRun {
+            auto data = std::make_shared<std::vector<RGBA>>(size.width * size.height, RGBA{255, 255, 255, 255});
+            auto fill = std::make_shared<FloodFill>();
+            return [=] {
+                // alternate colors so every run refills the whole canvas
+                RGBA color = (*data)[0].r ? RGBA{0, 0, 0, 255} : RGBA{255, 255, 255, 255};
+                fillBucket(*fill, *data, size.width, size.height, size.width / 2, size.height / 2,
+                           color, 0, false);
+                return double(size.width) * size.height;
+            };
+        }},
+        {"eraser_connected", false, [](const BenchSize &size) -> BenchRun {
+            auto data = std::make_shared<std::vector<RGBA>>(size.width * size.height, RGBA{0, 0, 0, 255});
+            auto fill = std::make_shared<FloodFill>();
+            return [=] {
+                std::fill(data->begin(), data->end(), RGBA{0, 0, 0, 255});
+                eraserConnected(*fill, *data, size.width, size.height, size.width / 2, size.height / 2,
+                                RGBA{255, 255, 255, 255}, false);
+                return double(size.width) * size.height;
+            };
+        }},
+        {"load_image", false, [](const BenchSize &size) -> BenchRun {
+            QString file = QDir::temp().filePath(QString("canvas_bench_%1x%2.png").arg(size.width).arg(size.height));
+            if (!QFileInfo::exists(file)) {
+                saveImage(file, makeTestImage(size.width, size.height), size.width, size.height);
+            }
+            return [=] {
+                std::vector<RGBA> data;
+                int width, height;
+                loadImage(file, data, width, height);
+                return double(size.width) * size.height;
+            };
+        }},
+    };
+    return cases;
+}
+
+// ------ RUNNER ------
+
+/**
+ * @brief Times `bench` with the filters running on `threads` threads,
+ * repeating until `minSeconds` have passed (always at least once)
+ */
+BenchResult runCase(const BenchCase &bench, const BenchSize &size, int threads, double minSeconds) {
+    using clock = std::chrono::steady_clock;
+    setThreadCount(threads);
+    resetPeakMemory();
+
+    double pixels = 0;
+    int iterations = 0;
+    double elapsed = 0;
+    while (iterations == 0 || elapsed < minSeconds) {
+        BenchRun run = bench.prepare(size);
+        auto start = clock::now();
+        pixels += run();
+        elapsed += std::chrono::duration<double>(clock::now() - start).count();
+        iterations++;
+    }
+
+    return BenchResult{bench.name, size.width, size.height, threads, iterations,
+                       elapsed / iterations, pixels / 1e6 / elapsed, peakMemoryKB()};
+}
+
+void writeJson(const std::string &path, const std::vector<BenchResult> &results) {
+    std::ofstream out(path);
+    out << "{\n  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"width\": " << r.width << ", \"height\": " << r.height
+            << ", \"threads\": " << r.threads << ", \"iterations\": " << r.iterations
+            << ", \"seconds\": " << r.seconds << ", \"mpix_per_second\": " << r.mpix_per_second
+            << ", \"peak_memory_kb\": " << r.peak_memory_kb << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+std::vector<BenchSize> parseSizes(const QString &text) {
+    std::vector<BenchSize> sizes;
+    for (const QString &item : text.split(',', Qt::SkipEmptyParts)) {
+        QStringList parts = item.split('x');
+        if (parts.size() == 2) {
+            sizes.push_back({parts[0].toInt(), parts[1].toInt()});
+        }
+    }
+    return sizes;
+}
+
+std::vector<int> parseThreads(const QString &text) {
+    std::vector<int> threads;
+    for (const QString &item : text.split(',', Qt::SkipEmptyParts)) {
+        threads.push_back(std::max(1, item.toInt()));
+    }
+    return threads;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("canvas_bench");
+
+    QString defaultThreads = QString("1,%1").arg(std::max(2u, std::thread::hardware_concurrency()));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmark the Canvas2D filter and brush kernels.");
+    parser.addHelpOption();
+    QCommandLineOption sizesOption("sizes", "Comma separated WxH list.", "list", "500x500,1920x1080,3840x2160,7680x4320");
+    QCommandLineOption casesOption("cases", "Only run cases whose name starts with one of these prefixes.", "list");
+    QCommandLineOption threadsOption("threads", "Filter thread counts to measure scaling with.", "list", defaultThreads);
+    QCommandLineOption minTimeOption("min-time", "Minimum seconds spent per measurement.", "s", "0.5");
+    QCommandLineOption jsonOption("json", "Where to write the JSON report.", "file", "canvas_bench.json");
+    QCommandLineOption medianOption("median-radius", "Radius used by the median case.", "r", "3");
+    QCommandLineOption bilateralOption("bilateral-radius", "Radius used by the bilateral case.", "r", "3");
+    QCommandLineOption brushOption("brush-radius", "Radius used by the brush cases.", "r", "50");
+    parser.addOptions({sizesOption, casesOption, threadsOption, minTimeOption, jsonOption,
+                       medianOption, bilateralOption, brushOption});
+    parser.process(app);
+
+    std::vector<BenchSize> sizes = parseSizes(parser.value(sizesOption));
+    std::vector<int> threadCounts = parseThreads(parser.value(threadsOption));
+    QStringList prefixes = parser.value(casesOption).split(',', Qt::SkipEmptyParts);
+    double minSeconds = parser.value(minTimeOption).toDouble();
+
+    int medianRadius = parser.value(medianOption).toInt();
+    if (medianRadius < 1 || medianRadius > MAX_MEDIAN_RADIUS) {
+        std::fprintf(stderr, "--median-radius must be between 1 and %d\n", MAX_MEDIAN_RADIUS);
+        return 1;
+    }
+
+    std::vector<BenchCase> cases = allCases(medianRadius,
+                                            parser.value(bilateralOption).toInt(),
+                                            parser.value(brushOption).toInt());
+
+    std::vector<BenchResult> results;
+    std::printf("%-18s %11s %7s %6s %12s %12s %12s\n",
+                "case", "size", "threads", "iters", "ms/iter", "MPix/s", "peak MB");
+    for (const BenchCase &bench : cases) {
+        bool selected = prefixes.isEmpty();
+        for (const QString &prefix : prefixes) {
+            selected |= QString::fromStdString(bench.name).startsWith(prefix);
+        }
+        if (!selected) {
+            continue;
+        }
+        for (const BenchSize &size : sizes) {
+            for (int threads : threadCounts) {
+                if (threads > 1 && !bench.scales_with_threads) {
+                    continue;
+                }
+                BenchResult r = runCase(bench, size, threads, minSeconds);
+                std::printf("%-18s %5dx%-5d %7d %6d %12.2f %12.2f %12.1f\n",
+                            r.name.c_str(), r.width, r.height, r.threads, r.iterations,
+                            r.seconds * 1000, r.mpix_per_second, r.peak_memory_kb / 1024.0);
+                std::fflush(stdout);
+                results.push_back(r);
+            }
+        }
+    }
+
+    writeJson(parser.value(jsonOption).toStdString(), results);
+    return 0;
+}
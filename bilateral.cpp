@@ -0,0 +1,188 @@
+#include "bilateral.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+static float _gaussian(float x, double sigma) {
+    return (1/(sqrt(2*M_PI*pow(sigma, 2)))) * (exp(-(pow(x,2) / (2 * pow(sigma, 2)))));
+}
+
+static std::uint8_t toUint8(float x) {
+    return std::clamp(x, 0.f, 255.f) + 0.5f;
+}
+
+void bilateralFilter(const std::vector<RGBA> &data, int width, int height, int radius, double sigma_s, double sigma_r, std::vector<RGBA> &result) {
+    int size = 2*radius + 1;
+
+    // spatial weight of every window offset, computed once per radius
+    std::vector<float> space(size * size);
+    for (int r = -radius; r <= radius; r++) {
+        for (int c = -radius; c <= radius; c++) {
+            space[(r + radius) * size + (c + radius)] = _gaussian(sqrt(float(r*r + c*c)), sigma_s);
+        }
+    }
+    // range weight for every possible |difference| of an 8 bit channel
+    float range[256];
+    for (int d = 0; d < 256; d++) {
+        range[d] = _gaussian(d / 255.0, sigma_r);
+    }
+
+    result.resize(data.size());
+    parallelFor(0, height, 4, [&](int begin, int end) {
+        for (int row = begin; row < end; row++) {
+            int r0 = std::max(-radius, -row);
+            int r1 = std::min(radius, height - 1 - row);
+            for (int col = 0; col < width; col++) {
+                int c0 = std::max(-radius, -col);
+                int c1 = std::min(radius, width - 1 - col);
+                const RGBA center = data[size_t(row) * width + col];
+
+                float acc_red = 0, acc_green = 0, acc_blue = 0;
+                float Wp_r = 0, Wp_g = 0, Wp_b = 0;
+                for (int r = r0; r <= r1; r++) {
+                    const RGBA *src = &data[size_t(row + r) * width + col];
+                    const float *space_row = &space[(r + radius) * size + radius];
+                    for (int c = c0; c <= c1; c++) {
+                        const RGBA p = src[c];
+                        float s = space_row[c];
+                        float w_r = s * range[std::abs(center.r - p.r)];
+                        float w_g = s * range[std::abs(center.g - p.g)];
+                        float w_b = s * range[std::abs(center.b - p.b)];
+                        acc_red += w_r * p.r;
+                        acc_green += w_g * p.g;
+                        acc_blue += w_b * p.b;
+                        Wp_r += w_r;
+                        Wp_g += w_g;
+                        Wp_b += w_b;
+                    }
+                }
+                result[size_t(row) * width + col] = RGBA{toUint8(acc_red / Wp_r), toUint8(acc_green / Wp_g), toUint8(acc_blue / Wp_b), 255};
+            }
+        }
+    });
+}
+
+namespace {
+
+// cells of padding around the grid, enough for the [1 4 6 4 1] blur and
+// the +1 neighbour read by the trilinear slice
+constexpr int PAD = 2;
+
+/**
+ * @brief One channel's bilateral grid. Every cell holds (weighted value, weight).
+ */
+struct Grid {
+    int nx, ny, nz;
+    std::vector<float> cells;
+
+    Grid(int nx, int ny, int nz) : nx(nx), ny(ny), nz(nz), cells(size_t(nx) * ny * nz * 2, 0.f) {}
+
+    float *at(int x, int y, int z) {
+        return &cells[((size_t(y) * nx + x) * nz + z) * 2];
+    }
+};
+
+/**
+ * @brief Blurs the grid with [1 4 6 4 1]/16 along one axis (0 = x, 1 = y,
+ * 2 = intensity)
+ */
+void blurAxis(Grid &grid, std::vector<float> &scratch, int axis) {
+    scratch = grid.cells;
+    size_t stride = axis == 0 ? grid.nz : (axis == 1 ? size_t(grid.nx) * grid.nz : 1);
+    int n = axis == 0 ? grid.nx : (axis == 1 ? grid.ny : grid.nz);
+    const float k[5] = {1/16.f, 4/16.f, 6/16.f, 4/16.f, 1/16.f};
+    parallelFor(0, grid.ny, 4, [&](int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            for (int x = 0; x < grid.nx; x++) {
+                for (int z = 0; z < grid.nz; z++) {
+                    int i = axis == 0 ? x : (axis == 1 ? y : z);
+                    size_t cell = (size_t(y) * grid.nx + x) * grid.nz + z;
+                    float value = 0, weight = 0;
+                    for (int t = -2; t <= 2; t++) {
+                        if (i + t < 0 || i + t >= n) {
+                            continue;
+                        }
+                        const float *src = &scratch[(cell + t * std::ptrdiff_t(stride)) * 2];
+                        value += k[t + 2] * src[0];
+                        weight += k[t + 2] * src[1];
+                    }
+                    grid.cells[cell * 2] = value;
+                    grid.cells[cell * 2 + 1] = weight;
+                }
+            }
+        }
+    });
+}
+
+} // namespace
+
+void bilateralGrid(const std::vector<RGBA> &data, int width, int height, double sigma_s, double sigma_r, std::vector<RGBA> &result) {
+    float cell_s = sigma_s;
+    float cell_r = sigma_r * 255;
+    int nx = int((width - 1) / cell_s) + 1 + 2*PAD;
+    int ny = int((height - 1) / cell_s) + 1 + 2*PAD;
+    int nz = int(255 / cell_r) + 1 + 2*PAD;
+
+    result.assign(data.size(), RGBA{0, 0, 0, 255});
+    std::vector<float> scratch;
+    for (int c = 0; c < 3; c++) {
+        auto channel = [c](const RGBA &p) { return c == 0 ? p.r : (c == 1 ? p.g : p.b); };
+        Grid grid(nx, ny, nz);
+
+        // splat: every pixel lands in its nearest cell. Grid rows are
+        // handed out to threads, so no two threads write the same cell.
+        parallelFor(0, ny, 4, [&](int begin, int end) {
+            for (int gy = begin; gy < end; gy++) {
+                int row0 = std::max(0, int((gy - PAD - 0.5f) * cell_s) - 1);
+                int row1 = std::min(height - 1, int((gy - PAD + 0.5f) * cell_s) + 1);
+                for (int row = row0; row <= row1; row++) {
+                    if (int(row / cell_s + 0.5f) + PAD != gy) {
+                        continue;
+                    }
+                    for (int col = 0; col < width; col++) {
+                        float v = channel(data[size_t(row) * width + col]);
+                        float *cell = grid.at(int(col / cell_s + 0.5f) + PAD, gy, int(v / cell_r + 0.5f) + PAD);
+                        cell[0] += v;
+                        cell[1] += 1;
+                    }
+                }
+            }
+        });
+
+        for (int axis = 0; axis < 3; axis++) {
+            blurAxis(grid, scratch, axis);
+        }
+
+        // slice: trilinear lookup at (x, y, own intensity)
+        parallelFor(0, height, 8, [&](int begin, int end) {
+            for (int row = begin; row < end; row++) {
+                float fy = row / cell_s + PAD;
+                int y0 = int(fy);
+                float ty = fy - y0;
+                for (int col = 0; col < width; col++) {
+                    RGBA &out = result[size_t(row) * width + col];
+                    float v = channel(data[size_t(row) * width + col]);
+                    float fx = col / cell_s + PAD;
+                    float fz = v / cell_r + PAD;
+                    int x0 = int(fx), z0 = int(fz);
+                    float tx = fx - x0, tz = fz - z0;
+
+                    float value = 0, weight = 0;
+                    for (int dy = 0; dy < 2; dy++) {
+                        for (int dx = 0; dx < 2; dx++) {
+                            for (int dz = 0; dz < 2; dz++) {
+                                float w = (dy ? ty : 1 - ty) * (dx ? tx : 1 - tx) * (dz ? tz : 1 - tz);
+                                const float *cell = grid.at(x0 + dx, y0 + dy, z0 + dz);
+                                value += w * cell[0];
+                                weight += w * cell[1];
+                            }
+                        }
+                    }
+                    std::uint8_t filtered = weight > 0 ? toUint8(value / weight) : std::uint8_t(v);
+                    (c == 0 ? out.r : (c == 1 ? out.g : out.b)) = filtered;
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef BILATERAL_H
+#define BILATERAL_H
+
+#include <vector>
+#include "rgba.h"
+
+/**
+ * @file    bilateral.h
+ *
+ * Bilateral smoothing for FILTER_BILATERAL, in two flavours:
+ *
+ * - bilateralFilter: the exact filter over a (2r+1)x(2r+1) window. The
+ *   spatial weights are computed once per radius and the range weight is a
+ *   256 entry table indexed by |difference|, so the inner loop is two table
+ *   lookups and a few multiply-adds per channel.
+ *
+ * - bilateralGrid: the bilateral grid approximation (Paris & Durand 2006).
+ *   Each channel is splatted into a 3D grid with one cell per sigma_s
+ *   pixels and per sigma_r of intensity, blurred there and sliced back with
+ *   trilinear interpolation. The cost is O(pixels) whatever the radius; the
+ *   spatial support is effectively unbounded, so it matches the exact
+ *   filter once radius >= 3 * sigma_s.
+ *
+ *   Error versus bilateralFilter (radius 9, sigma_s 3, sigma_r 0.1),
+ *   measured on the canvas_bench test image and on a pattern of intensity
+ *   steps 13 levels apart (about half of sigma_r): mean absolute error
+ *   below 0.5 levels, maximum 3 levels out of 255. Expect the largest
+ *   differences on edges whose contrast is close to sigma_r, where the
+ *   coarse intensity axis of the grid blends the two sides a little.
+ */
+
+// both write the filtered image to `result` (resized to fit, must not be `data`)
+void bilateralFilter(const std::vector<RGBA> &data, int width, int height, int radius, double sigma_s, double sigma_r, std::vector<RGBA> &result);
+void bilateralGrid(const std::vector<RGBA> &data, int width, int height, double sigma_s, double sigma_r, std::vector<RGBA> &result);
+
+#endif // BILATERAL_H
@@ -0,0 +1,140 @@
+#include "blend.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static inline std::uint8_t blendChannel(int d, int s, int k) {
+    return (d * (256 - k) + s * k + 128) >> 8;
+}
+
+static inline RGBA blendPixel(RGBA d, RGBA s, int k) {
+    return RGBA{blendChannel(d.r, s.r, k), blendChannel(d.g, s.g, k), blendChannel(d.b, s.b, k), d.a};
+}
+
+#if defined(__SSE2__)
+/**
+ * @brief Blends 4 pixels of `d` towards `s` with the 4 coverages in the low
+ * half of `k4`
+ */
+static inline __m128i blend4(__m128i d, __m128i s, __m128i k4) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(256);
+    const __m128i half = _mm_set1_epi16(128);
+    // coverage of pixel i in the r, g, b lanes of that pixel, 0 in its alpha lane
+    const __m128i rgb = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    __m128i kk = _mm_unpacklo_epi16(k4, k4);
+    __m128i k_lo = _mm_and_si128(_mm_unpacklo_epi32(kk, kk), rgb);
+    __m128i k_hi = _mm_and_si128(_mm_unpackhi_epi32(kk, kk), rgb);
+
+    // at most 255 * 256 + 128, so the sums fit in unsigned 16 bits
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(full, k_lo)),
+                               _mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), k_lo));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(full, k_hi)),
+                               _mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), k_hi));
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, half), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, half), 8);
+    return _mm_packus_epi16(lo, hi);
+}
+
+/**
+ * @brief (cov * alpha) >> 8 for 8 lanes with cov, alpha <= 256; the product
+ * can be 65536, so it is put together from its high and low 16 bits
+ */
+static inline __m128i scaleCoverage(__m128i cov, __m128i alpha) {
+    __m128i hi = _mm_mulhi_epu16(cov, alpha);
+    __m128i lo = _mm_mullo_epi16(cov, alpha);
+    return _mm_or_si128(_mm_slli_epi16(hi, 8), _mm_srli_epi16(lo, 8));
+}
+
+static inline __m128i loadColor(RGBA color) {
+    std::int32_t packed;
+    std::memcpy(&packed, &color, sizeof(packed));
+    return _mm_set1_epi32(packed);
+}
+#endif
+
+void blendRow(RGBA *dst, RGBA color, const std::uint16_t *coverage, int alpha, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i s = loadColor(color);
+    __m128i a = _mm_set1_epi16(alpha);
+    for (; i + 4 <= n; i += 4) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i k4 = scaleCoverage(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(coverage + i)), a);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), blend4(d, s, k4));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = blendPixel(dst[i], color, (coverage[i] * alpha) >> 8);
+    }
+}
+
+void blendRow(RGBA *dst, const RGBA *src, const std::uint16_t *k, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i k4 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), blend4(d, s, k4));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = blendPixel(dst[i], src[i], k[i]);
+    }
+}
+
+void lerpRow(RGBA *dst, const RGBA *src, int k, int n) {
+    if (k >= 256) {
+        std::memcpy(dst, src, sizeof(RGBA) * n);
+        return;
+    }
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i k4 = _mm_set1_epi16(k);
+    for (; i + 4 <= n; i += 4) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), blend4(d, s, k4));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = blendPixel(dst[i], src[i], k);
+    }
+}
+
+void blendRowStroke(RGBA *dst, RGBA *base, std::uint16_t *coverage, RGBA color,
+                    const std::uint16_t *mask, int alpha, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i s = loadColor(color);
+    __m128i a = _mm_set1_epi16(alpha);
+    for (; i + 4 <= n; i += 4) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(base + i));
+        __m128i c4 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(coverage + i));
+        __m128i k4 = scaleCoverage(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(mask + i)), a);
+
+        // untouched pixels (coverage 0) take the current color as their base
+        __m128i fresh = _mm_cmpeq_epi16(c4, _mm_setzero_si128());
+        fresh = _mm_unpacklo_epi16(fresh, fresh);
+        b = _mm_or_si128(_mm_and_si128(fresh, d), _mm_andnot_si128(fresh, b));
+        // coverage is at most 256, so the signed max is fine
+        c4 = _mm_max_epi16(c4, k4);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(base + i), b);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(coverage + i), c4);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), blend4(b, s, c4));
+    }
+#endif
+    for (; i < n; i++) {
+        if (coverage[i] == 0) {
+            base[i] = dst[i];
+        }
+        coverage[i] = std::max<std::uint16_t>(coverage[i], (mask[i] * alpha) >> 8);
+        dst[i] = blendPixel(base[i], color, coverage[i]);
+    }
+}
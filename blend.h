@@ -0,0 +1,37 @@
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <cstdint>
+#include "rgba.h"
+
+/**
+ * @file    blend.h
+ *
+ * Row kernels used by drawStamp. Coverage `k` is fixed point in [0, 256]
+ * (256 = fully replace), and every channel is blended as
+ *
+ *     out = (dst * (256 - k) + src * k + 128) >> 8
+ *
+ * in 16-bit lanes, four pixels per SSE2 step. The scalar tail (and the
+ * fallback without SSE2) uses the same integer formula, so the result does
+ * not depend on the instruction set. Alpha is never modified.
+ */
+
+// dst[i] = blend(dst[i], color, (coverage[i] * alpha) >> 8), alpha in [0, 256]
+void blendRow(RGBA *dst, RGBA color, const std::uint16_t *coverage, int alpha, int n);
+
+// dst[i] = blend(dst[i], src[i], k[i])
+void blendRow(RGBA *dst, const RGBA *src, const std::uint16_t *k, int n);
+
+// dst[i] = blend(dst[i], src[i], k) with one k for the whole row; k = 256 copies src
+void lerpRow(RGBA *dst, const RGBA *src, int k, int n);
+
+// Stroke compositing for fixAlphaBlending: each pixel is blended from the
+// color it had before the stroke (`base`, saved the first time the pixel is
+// seen, i.e. while `coverage` is 0) with the largest coverage the stroke has
+// given it so far, so overlapping stamps do not build up alpha. The stamp's
+// coverage is (mask[i] * alpha) >> 8 as in blendRow.
+void blendRowStroke(RGBA *dst, RGBA *base, std::uint16_t *coverage, RGBA color,
+                    const std::uint16_t *mask, int alpha, int n);
+
+#endif // BLEND_H
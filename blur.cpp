@@ -0,0 +1,125 @@
+#include "blur.h"
+#include "filter.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+int reflectIndex(int i, int n) {
+    if (i < 0) {
+        i = -i;
+    } else if (i >= n) {
+        i = (n-1) - (i % n);
+    }
+    // kernels wider than the image reflect past the opposite border
+    return std::clamp(i, 0, n-1);
+}
+
+/**
+ * @brief acc[i] += weight * src[i] for i in [0, n)
+ */
+void addScaled(float *acc, const float *src, float weight, int n) {
+    int i = 0;
+#if defined(__AVX2__)
+    __m256 w8 = _mm256_set1_ps(weight);
+    for (; i + 8 <= n; i += 8) {
+#if defined(__FMA__)
+        __m256 sum = _mm256_fmadd_ps(w8, _mm256_loadu_ps(src + i), _mm256_loadu_ps(acc + i));
+#else
+        __m256 sum = _mm256_add_ps(_mm256_mul_ps(w8, _mm256_loadu_ps(src + i)), _mm256_loadu_ps(acc + i));
+#endif
+        _mm256_storeu_ps(acc + i, sum);
+    }
+#endif
+#if defined(__SSE2__)
+    __m128 w4 = _mm_set1_ps(weight);
+    for (; i + 4 <= n; i += 4) {
+        __m128 sum = _mm_add_ps(_mm_mul_ps(w4, _mm_loadu_ps(src + i)), _mm_loadu_ps(acc + i));
+        _mm_storeu_ps(acc + i, sum);
+    }
+#endif
+    for (; i < n; i++) {
+        acc[i] += weight * src[i];
+    }
+}
+
+static std::uint8_t toUint8(float x) {
+    return std::clamp(x, 0.f, 255.f) + 0.5f;
+}
+
+void gaussianBlur(const std::vector<RGBA> &data, int width, int height, int radius, std::vector<RGBA> &result) {
+    if (radius <= 0 || width == 0 || height == 0) {
+        result = data;
+        return;
+    }
+    std::vector<float> filter = createBlurFilter(radius);
+    int taps = 2*radius + 1;
+    int line = 4*width;
+    result.resize(data.size());
+
+    // every band needs 2r extra horizontal rows to prime its ring: bands are
+    // two per thread (for stealing), but at least 4r rows so priming stays
+    // under half the band, unless that would leave threads without one
+    int threads = threadCount();
+    int per_thread = (height + threads - 1) / threads;
+    int band = std::max((height + 2*threads - 1) / (2*threads), std::min(std::max(16, 4*radius), per_thread));
+    int bands = (height + band - 1) / band;
+
+    parallelFor(0, bands, 1, [&](int first_band, int last_band) {
+        std::vector<float> padded(4*(width + 2*radius));
+        std::vector<float> ring(size_t(line) * taps);
+        std::vector<float> acc(line);
+
+        // horizontal pass of (reflected) row y into its ring slot: pad the
+        // row with reflected pixels, then every tap is one addScaled over the
+        // whole row shifted by that tap
+        auto horizontal = [&](int y) -> float * {
+            return &ring[size_t((y % taps + taps) % taps) * line];
+        };
+        auto filterRow = [&](int y) {
+            const RGBA *src = &data[size_t(reflectIndex(y, height)) * width];
+            auto put = [&](int x, const RGBA &p) {
+                padded[4*x] = p.r;
+                padded[4*x+1] = p.g;
+                padded[4*x+2] = p.b;
+                padded[4*x+3] = 0;
+            };
+            for (int x = 0; x < radius; x++) {
+                put(x, src[reflectIndex(x - radius, width)]);
+                put(radius + width + x, src[reflectIndex(width + x, width)]);
+            }
+            for (int x = 0; x < width; x++) {
+                put(radius + x, src[x]);
+            }
+            float *out = horizontal(y);
+            std::fill(out, out + line, 0.f);
+            for (int tap = 0; tap < taps; tap++) {
+                addScaled(out, &padded[4*tap], filter[tap], line);
+            }
+        };
+
+        for (int b = first_band; b < last_band; b++) {
+            int begin = b * band;
+            int end = std::min(height, begin + band);
+            for (int y = begin - radius; y < begin + radius; y++) {
+                filterRow(y);
+            }
+            // vertical pass: the ring holds rows row-r .. row+r, one new
+            // horizontal row enters it per output row
+            for (int row = begin; row < end; row++) {
+                filterRow(row + radius);
+                std::fill(acc.begin(), acc.end(), 0.f);
+                for (int tap = 0; tap < taps; tap++) {
+                    addScaled(acc.data(), horizontal(row - radius + tap), filter[tap], line);
+                }
+                RGBA *dst = &result[size_t(row) * width];
+                for (int x = 0; x < width; x++) {
+                    dst[x] = RGBA{toUint8(acc[4*x]), toUint8(acc[4*x+1]), toUint8(acc[4*x+2]), 255};
+                }
+            }
+        }
+    });
+}
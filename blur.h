@@ -0,0 +1,31 @@
+#ifndef BLUR_H
+#define BLUR_H
+
+#include <vector>
+#include "rgba.h"
+
+/**
+ * @file    blur.h
+ *
+ * Separable Gaussian blur used by FILTER_BLUR. Both passes are written as
+ * "row += weight * row" over contiguous float buffers, which maps directly
+ * onto AVX2/SSE (with a plain scalar loop as fallback). Borders are handled
+ * once per row by padding it with reflected pixels, so the inner loops have
+ * no bounds checks. The passes are streamed: each band of rows keeps a ring
+ * of 2r+1 horizontally filtered float rows and the vertical pass reads from
+ * it as the band moves down, so there is no full-size float intermediate.
+ */
+
+// blurs `data` with a normalized Gaussian of the given radius (sigma = radius / 3)
+// into `result` (resized to fit, must not be `data`)
+void gaussianBlur(const std::vector<RGBA> &data, int width, int height, int radius, std::vector<RGBA> &result);
+
+// index of pixel `i` on a line of `n` pixels, reflected at both ends: -i
+// before the start, n-1 - (i mod n) past the end, clamped for kernels wider
+// than the line. The blur and edge kernels share this border rule
+int reflectIndex(int i, int n);
+
+// acc[i] += weight * src[i] for i in [0, n), vectorized; also used by scale.cpp
+void addScaled(float *acc, const float *src, float weight, int n);
+
+#endif // BLUR_H
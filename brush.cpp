@@ -0,0 +1,295 @@
+#include "brush.h"
+#include "blend.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <mutex>
+using namespace std;
+
+//helper functions
+static int pos2index(int x, int y, int width) {
+    return y*width+x;
+}
+
+void SmudgeBuffer::begin(const std::vector<RGBA> &data, int width, int height, int radius, int col, int row) {
+    m_radius = radius;
+    int size = 2*radius+1;
+    // resize() keeps the allocation, so only a bigger radius allocates
+    m_colors.resize(size*size);
+    std::fill(m_colors.begin(), m_colors.end(), RGBA{0, 0, 0, 0});
+    pickUp(data, width, height, col, row, 1.f);
+}
+
+void SmudgeBuffer::pickUp(const std::vector<RGBA> &data, int width, int height, int col, int row, float strength) {
+    int size = 2*m_radius+1;
+    int start_col = col - m_radius;
+    int start_row = row - m_radius;
+    // only the part of the footprint on the canvas is read; the rest keeps what it carried
+    int i0 = std::max(0, -start_row);
+    int i1 = std::min(size, height-start_row);
+    int j0 = std::max(0, -start_col);
+    int j1 = std::min(size, width-start_col);
+    if (i0 >= i1 || j0 >= j1) {
+        return;
+    }
+    int k = std::clamp(int(std::lround(strength * 256)), 0, 256);
+    for (int i = i0; i < i1; i++) {
+        lerpRow(&m_colors[i*size + j0], &data[pos2index(start_col+j0, start_row+i, width)], k, j1-j0);
+    }
+}
+
+static std::shared_ptr<const BrushMask> buildBrushMask(int brushType, int radius) {
+    auto mask = std::make_shared<BrushMask>();
+    int r = radius;
+    int size = 2*r+1;
+    mask->type = brushType;
+    mask->radius = r;
+    mask->size = size;
+    mask->weights.assign(size*size, 0.f);
+    mask->spans.assign(size, BrushMask::Span{0, 0});
+
+    bool known = true;
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            int dx = j-r;
+            int dy = i-r;
+            double distance = round(sqrt(double(dx*dx+dy*dy)));
+            if (distance > r) {
+                continue;
+            }
+            float weight = 0;
+            switch (brushType) {
+              case BRUSH_CONSTANT:
+              case BRUSH_SPRAY:
+              case BRUSH_ERASER:
+                weight = 1;
+                break;
+              case BRUSH_LINEAR:
+                weight = std::max(0.0, 1-distance/r);
+                break;
+              case BRUSH_QUADRATIC:
+              case BRUSH_SMUDGE:
+                // C = 1; B = -2/r; A = 1/r^2
+                weight = std::max(0.0,(1.0/(r*r))*distance*distance-2.0/r*distance+1);
+                break;
+              case BRUSH_ERASER_CONNECTED:
+                break;
+              default:
+                known = false;
+            }
+            mask->weights[i*size+j] = weight;
+        }
+
+        // the non-zero part of the row, the only part drawStamp visits
+        const float *row = &mask->weights[i*size];
+        int begin = 0;
+        int end = size;
+        while (begin < end && row[begin] == 0) {
+            begin++;
+        }
+        while (end > begin && row[end-1] == 0) {
+            end--;
+        }
+        mask->spans[i] = BrushMask::Span{begin, end};
+    }
+
+    mask->coverage.resize(mask->weights.size());
+    for (std::size_t i = 0; i < mask->weights.size(); i++) {
+        mask->coverage[i] = std::uint16_t(std::lround(mask->weights[i] * 256));
+        if (mask->coverage[i] > 0) {
+            mask->cells.push_back(int(i));
+        }
+    }
+    if (!known) {
+        std::cout << "INVALID BRUSH TYPE";
+    }
+    return mask;
+}
+
+std::shared_ptr<const BrushMask> createBrushMask(int brushType, int radius) {
+    // masks never change once built, so the canvas, the batch tool and the
+    // benchmark threads can all share them; switching back to a recent
+    // (type, radius) pair costs nothing
+    static std::mutex cache_mutex;
+    static std::deque<std::shared_ptr<const BrushMask>> cache;
+    const std::size_t cache_size = 16;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    for (const auto &mask : cache) {
+        if (mask->type == brushType && mask->radius == radius) {
+            return mask;
+        }
+    }
+    cache.push_back(buildBrushMask(brushType, radius));
+    if (cache.size() > cache_size) {
+        cache.pop_front();
+    }
+    return cache.back();
+}
+
+void AlphaStroke::begin(int w, int h) {
+    if (w != width || h != height) {
+        width = w;
+        height = h;
+        coverage.assign(std::size_t(w) * h, 0);
+        base.resize(std::size_t(w) * h);
+    }
+    m_x0 = m_y0 = m_x1 = m_y1 = 0;
+}
+
+void AlphaStroke::end() {
+    for (int y = m_y0; y < m_y1; y++) {
+        std::fill(coverage.begin() + pos2index(m_x0, y, width), coverage.begin() + pos2index(m_x1, y, width), 0);
+    }
+    m_x0 = m_y0 = m_x1 = m_y1 = 0;
+}
+
+void AlphaStroke::touch(int x0, int y0, int x1, int y1) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, width);
+    y1 = std::min(y1, height);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    if (m_x0 >= m_x1) {
+        m_x0 = x0; m_y0 = y0; m_x1 = x1; m_y1 = y1;
+        return;
+    }
+    m_x0 = std::min(m_x0, x0);
+    m_y0 = std::min(m_y0, y0);
+    m_x1 = std::max(m_x1, x1);
+    m_y1 = std::max(m_y1, y1);
+}
+
+// splitmix64 finalizer of seed + counter: a stateless generator, so any
+// stamp can be drawn on any thread and still come out the same
+static inline std::uint64_t sprayRandom(std::uint64_t seed, std::uint64_t counter) {
+    std::uint64_t z = seed + counter * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// uniform integer in [0, n)
+static inline std::size_t sprayPick(std::uint64_t random, std::size_t n) {
+    return std::size_t(((random >> 32) * n) >> 32);
+}
+
+/**
+ * @brief Paints the expected number of spray dots directly instead of rolling
+ * the dice for every covered pixel. A pixel is hit with the same probability
+ * as the old `rand() % 100 <= density/6` test, the count is rounded up or down
+ * at random so it is right on average, and no pixel is picked twice.
+ */
+static void sprayStamp(std::vector<RGBA> &data, int width, int height, const BrushMask &brush,
+                       RGBA color, int alpha, int density, int start_col, int start_row, std::uint64_t seed) {
+    std::size_t cells = brush.cells.size();
+    if (cells == 0) {
+        return;
+    }
+    std::uint64_t counter = 0;
+    double expected = cells * ((density/6 + 1) / 100.0);
+    std::size_t hits = std::size_t(expected);
+    if ((sprayRandom(seed, counter++) >> 11) * 0x1.0p-53 < expected - hits) {
+        hits++;
+    }
+    hits = std::min(hits, cells);
+
+    thread_local std::vector<std::uint64_t> taken;
+    taken.assign((cells + 63) / 64, 0);
+    for (std::size_t drawn = 0; drawn < hits; ) {
+        std::size_t c = sprayPick(sprayRandom(seed, counter++), cells);
+        if (taken[c >> 6] >> (c & 63) & 1) {
+            continue;
+        }
+        taken[c >> 6] |= std::uint64_t(1) << (c & 63);
+        drawn++;
+
+        int cell = brush.cells[c];
+        int x = start_col + cell % brush.size;
+        int y = start_row + cell / brush.size;
+        if (0 <= x && x < width && 0 <= y && y < height) {
+            blendRow(&data[pos2index(x, y, width)], color, &brush.coverage[cell], alpha, 1);
+        }
+    }
+}
+
+void drawStamp(std::vector<RGBA> &data, int width, int height, const BrushMask &brush,
+               const std::vector<RGBA> &prev_color, const Settings &settings, RGBA eraser_color,
+               int start_col, int start_row, AlphaStroke *stroke, std::uint64_t seed) {
+    int size = brush.size;
+    RGBA color = settings.brushColor;
+    // alpha in 1/256 steps, 255 -> 256
+    int alpha = settings.brushColor.a + (settings.brushColor.a >> 7);
+    if (brush.type == BRUSH_ERASER) {
+        color = eraser_color;
+        alpha = 256;
+    }
+    if (brush.type == BRUSH_SPRAY) {
+        sprayStamp(data, width, height, brush, color, alpha, settings.brushDensity, start_col, start_row, seed);
+        return;
+    }
+    if (brush.type == BRUSH_SMUDGE && prev_color.size() != std::size_t(size*size)) {
+        return; // no pickup for this radius yet
+    }
+    if (brush.type == BRUSH_SMUDGE
+            || (stroke && (stroke->width != width || stroke->height != height))) {
+        stroke = nullptr;
+    }
+
+    // clip the stamp to the canvas once, then visit only the covered spans
+    int row_begin = std::max(0, -start_row);
+    int row_end = std::min(size, height-start_row);
+    int col_begin = std::max(0, -start_col);
+    int col_end = std::min(size, width-start_col);
+    if (stroke) {
+        stroke->touch(start_col, start_row, start_col+size, start_row+size);
+    }
+
+    for (int i = row_begin; i < row_end; i++) {
+        int j0 = std::max(brush.spans[i].begin, col_begin);
+        int j1 = std::min(brush.spans[i].end, col_end);
+        int n = j1 - j0;
+        if (n <= 0) {
+            continue;
+        }
+        const std::uint16_t *cov = &brush.coverage[i*size + j0];
+        int canvas_idx = pos2index(start_col+j0, start_row+i, width);
+        RGBA *dst = &data[canvas_idx];
+
+        switch (brush.type) {
+          case BRUSH_SMUDGE:
+            // the picked-up colors are laid down at full opacity
+            blendRow(dst, &prev_color[i*size + j0], cov, n);
+            break;
+          default:
+            if (stroke) {
+                blendRowStroke(dst, &stroke->base[canvas_idx], &stroke->coverage[canvas_idx], color, cov, alpha, n);
+            } else {
+                blendRow(dst, color, cov, alpha, n);
+            }
+        }
+    }
+}
+
+
+FillRegion fillBucket(FloodFill &fill, std::vector<RGBA> &data, int width, int height, int col, int row,
+                      RGBA fill_color, int tolerance, bool eight_connected) {
+    if (col < 0 || row < 0 || col >= width || row >= height) {
+        return FillRegion{};
+    }
+    RGBA target_color = data[pos2index(col, row, width)];
+    FillRegion region = fill.select(data, width, height, col, row, target_color, tolerance, false, eight_connected);
+    fill.paint(data, fill_color);
+    return region;
+}
+
+FillRegion eraserConnected(FloodFill &fill, std::vector<RGBA> &data, int width, int height, int col, int row,
+                           RGBA init_color, bool eight_connected) {
+    // everything connected to the click that is not background yet
+    FillRegion region = fill.select(data, width, height, col, row, init_color, 0, true, eight_connected);
+    fill.paint(data, init_color);
+    return region;
+}
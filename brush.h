@@ -0,0 +1,95 @@
+#ifndef BRUSH_H
+#define BRUSH_H
+
+#include <memory>
+#include <vector>
+#include "floodfill.h"
+#include "rgba.h"
+#include "settings.h"
+
+/**
+ * @file    brush.h
+ *
+ * The brush kernels used by Canvas2D. Like filter.h they work on a plain
+ * RGBA buffer, so they can be driven (and timed) without a widget.
+ */
+
+/**
+ * @brief A brush footprint: (2r+1)^2 row-major weights plus, for every row,
+ * the columns [begin, end) outside which the weights are zero.
+ * Masks are built once per (type, radius) and never modified afterwards.
+ */
+struct BrushMask {
+    struct Span {
+        int begin;
+        int end;
+    };
+
+    int type = 0;
+    int radius = 0;
+    int size = 1;
+    std::vector<float> weights;
+    std::vector<std::uint16_t> coverage; // weights in 1/256 steps, for the blend kernels
+    std::vector<int> cells;              // indices with non-zero coverage, the spray's candidates
+    std::vector<Span> spans;
+};
+
+/**
+ * @brief Per-stroke buffers for fixAlphaBlending: the largest coverage each
+ * pixel got during the stroke and its color before the stroke. Only pixels
+ * inside the touched rectangle are cleared again in end(), so a short stroke
+ * on a big canvas stays cheap.
+ */
+class AlphaStroke {
+public:
+    void begin(int width, int height);
+    void end();
+    void touch(int x0, int y0, int x1, int y1);
+
+    int width = 0;
+    int height = 0;
+    std::vector<std::uint16_t> coverage;
+    std::vector<RGBA> base;
+
+private:
+    int m_x0 = 0;
+    int m_y0 = 0;
+    int m_x1 = 0;
+    int m_y1 = 0;
+};
+
+/**
+ * @brief The colors a smudge brush carries, one per footprint pixel. The
+ * buffer lives for the whole session; each pickUp mixes the canvas under
+ * the (clipped) footprint into it by `strength` (1 = take the canvas as is).
+ */
+class SmudgeBuffer {
+public:
+    // starts a smudge stroke: picks up the footprint at (col, row) completely
+    void begin(const std::vector<RGBA> &data, int width, int height, int radius, int col, int row);
+    void pickUp(const std::vector<RGBA> &data, int width, int height, int col, int row, float strength);
+    const std::vector<RGBA> &colors() const { return m_colors; }
+
+private:
+    int m_radius = 0;
+    std::vector<RGBA> m_colors;
+};
+
+// basic brush-related function
+// returns the (shared, cached) mask for the given brush type and radius
+std::shared_ptr<const BrushMask> createBrushMask(int brushType, int radius);
+// blends one stamp with its top-left corner at (start_col, start_row). With `stroke`
+// (fixAlphaBlending), constant/linear/quadratic/eraser stamps composite per stroke.
+// The spray pattern depends only on `seed`, so give every stamp its own seed.
+void drawStamp(std::vector<RGBA> &data, int width, int height, const BrushMask &brush,
+               const std::vector<RGBA> &prev_color, const Settings &settings, RGBA eraser_color,
+               int start_col, int start_row, AlphaStroke *stroke = nullptr, std::uint64_t seed = 0);
+// fill bucket: recolor the region around (col, row) that is within `tolerance` of the clicked color.
+// `fill` keeps its visited mask between calls; the returned box covers every changed pixel.
+FillRegion fillBucket(FloodFill &fill, std::vector<RGBA> &data, int width, int height, int col, int row,
+                      RGBA fill_color, int tolerance, bool eight_connected);
+// my fun exploration
+FillRegion eraserConnected(FloodFill &fill, std::vector<RGBA> &data, int width, int height, int col, int row,
+                           RGBA init_color, bool eight_connected);
+
+#endif // BRUSH_H
@@ -1,10 +1,18 @@
 #include "canvas2d.h"
 #include <QPainter>
+#include <QPaintEvent>
 #include <QMessageBox>
 #include <QFileDialog>
+#include <QCoreApplication>
+#include <QPointer>
+#include <QThreadPool>
 #include <iostream>
+#include <algorithm>
 #include <cmath>
 #include "settings.h"
+#include "brush.h"
+#include "filtergraph.h"
+#include "imageio.h"
 #include <queue>
 using namespace std;
 
@@ -12,78 +20,206 @@ using namespace std;
  * @brief Initializes new 500x500 canvas
  */
 void Canvas2D::init() {
+    // stamps queued by mouse moves are drawn (and repainted) once per display frame
+    m_frameTimer.setInterval(16);
+    connect(&m_frameTimer, &QTimer::timeout, this, &Canvas2D::rasterizeStroke);
+    // one filter and one preview job at a time, so stopping either is a
+    // wait for its own pool
+    m_filterPool.setMaxThreadCount(1);
+    m_previewPool.setMaxThreadCount(1);
+    m_filterTimer.setInterval(100);
+    connect(&m_filterTimer, &QTimer::timeout, this, [this] {
+        if (m_filterJob) {
+            emit filterProgress(int(100 * m_filterJob->progress()));
+        }
+    });
+
     m_width = 500;
     m_height = 500;
+    m_history.setBudget(size_t(settings.historyBudget) << 20);
+    m_history.setCompression(settings.historyCompression);
     clearCanvas();
     updateBrush(settings);
-    prev_canvas.push_front(m_data);
+}
+
+Canvas2D::~Canvas2D() {
+    // the filter and preview jobs hold `this`: cancel them and wait for
+    // their own pools only. Loads in flight check their QPointer instead
+    cancelFilter();
+    m_filterPool.waitForDone();
+    hidePreview();
 }
 
 /**
  * @brief Canvas2D::clearCanvas sets all canvas pixels to blank white
  */
 void Canvas2D::clearCanvas() {
+    invalidatePreview();
     m_data.assign(m_width * m_height, RGBA{255, 255, 255, 255});
     settings.imagePath = "";
+    m_history.markAllDirty();
+    m_history.commit(m_data, m_width, m_height);
     displayImage();
 }
 
+/**
+ * @brief Undo the last stroke, fill or filter
+ */
 void Canvas2D::prevCanvas() {
-    if (prev_canvas.size()>0) {
-        m_data = prev_canvas.front();
-        prev_canvas.pop_front();
+    invalidatePreview();
+    if (m_history.undo(m_data, m_width, m_height)) {
+        displayImage();
+    }
+}
+
+/**
+ * @brief Redo the last undone step
+ */
+void Canvas2D::nextCanvas() {
+    invalidatePreview();
+    if (m_history.redo(m_data, m_width, m_height)) {
+        displayImage();
     }
-    displayImage();
 }
 
 /**
- * @brief Stores the image specified from the input file in this class's
- * `std::vector<RGBA> m_image`.
+ * @brief Loads the image specified from the input file into this class's
+ * `std::vector<RGBA> m_data` without blocking the UI: decoding (and the copy
+ * kept for revert) happens on a pool thread, and the decoded buffer is moved
+ * into m_data back on the UI thread. The decode can't be cancelled, so it
+ * reaches the canvas through a QPointer and is dropped if the canvas is gone.
  * Also saves the image width and height to canvas width and height respectively.
  * @param file: file path to an image
- * @return True if successfully loads image, False otherwise.
  */
-bool Canvas2D::loadImageFromFile(const QString &file) {
-    QImage myImage;
-    if (!myImage.load(file)) {
-        std::cout<<"Failed to load in image"<<std::endl;
-        return false;
+void Canvas2D::loadImageFromFile(const QString &file) {
+    int index = ++m_loadIndex;
+    emit loadProgress(0);
+    QPointer<Canvas2D> self(this);
+    QThreadPool::globalInstance()->start([self, file, index] {
+        auto data = std::make_shared<std::vector<RGBA>>();
+        int width = 0;
+        int height = 0;
+        bool ok = loadImage(file, *data, width, height, [self, index](int percent) {
+            QMetaObject::invokeMethod(qApp, [self, index, percent] {
+                if (self && index == self->m_loadIndex) {
+                    emit self->loadProgress(percent);
+                }
+            }, Qt::QueuedConnection);
+        });
+        std::shared_ptr<const std::vector<RGBA>> original;
+        if (ok) {
+            original = std::make_shared<const std::vector<RGBA>>(*data);
+        }
+
+        QMetaObject::invokeMethod(qApp, [=] {
+            if (!self || index != self->m_loadIndex) {
+                return;
+            }
+            if (!ok) {
+                std::cout<<"Failed to load in image"<<std::endl;
+                emit self->loadFinished(false);
+                return;
+            }
+            self->m_loadResult = std::move(*data);
+            self->m_loadOriginal = original;
+            self->m_loadPath = file;
+            self->m_loadWidth = width;
+            self->m_loadHeight = height;
+            self->m_loadPending = true;
+            // the stroke in progress keeps its buffer until mouseUp
+            if (!self->m_frameTimer.isActive()) {
+                self->adoptLoadedImage();
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+/**
+ * @brief Replaces the image with the one loaded last
+ */
+void Canvas2D::adoptLoadedImage() {
+    // a filter started on the previous image must not replace this one
+    cancelFilter();
+    invalidatePreview();
+    m_loadPending = false;
+    m_data.swap(m_loadResult);
+    m_loadResult = {};
+    m_width = m_loadWidth;
+    m_height = m_loadHeight;
+    m_original = std::move(m_loadOriginal);
+    m_originalPath = m_loadPath;
+    m_originalWidth = m_loadWidth;
+    m_originalHeight = m_loadHeight;
+    m_history.markAllDirty();
+    m_history.commit(m_data, m_width, m_height);
+    displayImage();
+    emit loadFinished(true);
+}
+
+/**
+ * @brief Restores the image at settings.imagePath as it was loaded
+ */
+void Canvas2D::revertImage() {
+    if (settings.imagePath.isEmpty()) {
+        return;
     }
-    myImage = myImage.convertToFormat(QImage::Format_RGBX8888);
-    m_width = myImage.width();
-    m_height = myImage.height();
-    QByteArray arr = QByteArray::fromRawData((const char*) myImage.bits(), myImage.sizeInBytes());
-
-    m_data.clear();
-    m_data.reserve(m_width * m_height);
-    for (int i = 0; i < arr.size() / 4.f; i++){
-        m_data.push_back(RGBA{(std::uint8_t) arr[4*i], (std::uint8_t) arr[4*i+1], (std::uint8_t) arr[4*i+2], (std::uint8_t) arr[4*i+3]});
+    if (!m_original || m_originalPath != settings.imagePath) {
+        loadImageFromFile(settings.imagePath);
+        return;
     }
+    invalidatePreview();
+    m_data = *m_original;
+    m_width = m_originalWidth;
+    m_height = m_originalHeight;
+    m_history.markAllDirty();
+    m_history.commit(m_data, m_width, m_height);
     displayImage();
-    return true;
 }
 
 /**
  * @brief Get Canvas2D's image data and display this to the GUI
  */
 void Canvas2D::displayImage() {
-    QByteArray* img = new QByteArray(reinterpret_cast<const char*>(m_data.data()), 4*m_data.size());
-    QImage now = QImage((const uchar*)img->data(), m_width, m_height, QImage::Format_RGBX8888);
-    setPixmap(QPixmap::fromImage(now));
-    setFixedSize(m_width, m_height);
+    // the whole image changed: the proxies are stale
+    invalidatePreview();
+    wrapImage();
+    if (size() != QSize(m_width, m_height)) {
+        setFixedSize(m_width, m_height);
+    }
+    m_dirty = QRect();
     update();
 }
 
+/**
+ * @brief Repaints only the area touched since the last repaint
+ */
+void Canvas2D::displayDirty() {
+    if (!m_dirty.isEmpty()) {
+        update(m_dirty.intersected(QRect(0, 0, m_width, m_height)));
+        m_dirty = QRect();
+    }
+}
 
 /**
- * @brief Get Canvas2D's image data and display this to the GUI
+ * @brief Points m_image at m_data without copying. Needed again whenever
+ * m_data is reallocated or the canvas changes size.
  */
-void Canvas2D::myDisplayImage(vector<RGBA> &data, int width, int height) {
-    QByteArray* img = new QByteArray(reinterpret_cast<const char*>(data.data()), 4*data.size());
-    QImage now = QImage((const uchar*)img->data(), width, height, QImage::Format_RGBX8888);
-    setPixmap(QPixmap::fromImage(now));
-    setFixedSize(width, height);
-    update();
+void Canvas2D::wrapImage() {
+    const uchar *pixels = reinterpret_cast<const uchar*>(m_data.data());
+    if (m_image.constBits() != pixels || m_image.width() != m_width || m_image.height() != m_height) {
+        m_image = QImage(pixels, m_width, m_height, 4*m_width, QImage::Format_RGBX8888);
+    }
+}
+
+void Canvas2D::paintEvent(QPaintEvent *event) {
+    QPainter painter(this);
+    if (!m_preview.isNull()) {
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.drawImage(rect(), m_preview);
+        return;
+    }
+    wrapImage();
+    painter.drawImage(event->rect(), m_image, event->rect());
 }
 
 
@@ -93,6 +229,7 @@ void Canvas2D::myDisplayImage(vector<RGBA> &data, int width, int height) {
  * @param h
  */
 void Canvas2D::resize(int w, int h) {
+    invalidatePreview();
     m_width = w;
     m_height = h;
     m_data.resize(w * h);
@@ -101,629 +238,344 @@ void Canvas2D::resize(int w, int h) {
 
 
 /**
- * @brief Called when the filter button is pressed in the UI
+ * @brief Called when the filter button is pressed in the UI. The filter runs
+ * on a pool thread on a snapshot of the image and the settings, so painting,
+ * undo and settings changes keep working meanwhile; edits made in that time
+ * are replaced by the result but stay in the undo history.
  */
 void Canvas2D::filterImage() {
-    // Filter TODO: apply the currently selected filter to the loaded image
-    switch (settings.filterType) {
-      case FILTER_BLUR: {
-        std::vector<float> filter = createBlurFilter();
-        int filter_width = settings.blurRadius*2+1;
-        int filter_height = 1;
-        auto first_pass = convolve2D(m_data, filter, filter_width, filter_height, false);
-        auto second_pass = convolve2D(first_pass, filter, filter_height, filter_width, false);
-        updateCanvas(second_pass);
-        displayImage();
-        break;
-      }
-      case FILTER_EDGE_DETECT: {
-        filterGray(m_data);
-        std::vector<float> sobel_x_row = {-1, 0, 1};
-        std::vector<float> sobel_x_col = {1, 2, 1};
-        auto first_pass_x = convolve2D(m_data, sobel_x_row, 3, 1, true);
-        auto second_pass_x = convolve2D(first_pass_x, sobel_x_col, 1, 3, true);
-        std::vector<float> sobel_y_row = {1, 2, 1};
-        std::vector<float> sobel_y_col = {1, 0, -1};
-        auto first_pass_y = convolve2D(m_data, sobel_y_row, 3, 1, true);
-        auto second_pass_y = convolve2D(first_pass_y, sobel_y_col, 1, 3, true);
-
-        auto result = getEdgeMagnitude(second_pass_x, second_pass_y);
-        updateCanvas(result);
-        displayImage();
-        break;
-      }
-      case FILTER_SCALE: {
-        int output_width = round(m_width*settings.scaleX);
-        int output_height = round(m_height*settings.scaleY);
-        auto scaledX = getScaledImageX(m_data, m_width, m_height, settings.scaleX, output_width, m_height);
-        auto scaledY = getScaledImageY(scaledX, output_width, m_height, settings.scaleY, output_width, output_height);
-        resize(output_width, output_height);
-        updateCanvas(scaledY);
-        displayImage();
-        break;
-      }
-      case FILTER_MEDIAN: {
-        vector<RGBA> res = convolve2D_medium(m_data, settings.medianRadius);
-        updateCanvas(res);
-        displayImage();
-        break;
-      }
-      case FILTER_BILATERAL: {
-        double sigma_s = 3.0;
-        double sigma_r = 0.1;
-        vector<RGBA> res = convolve2D_bilateral(m_data, settings.bilateralRadius, sigma_s, sigma_r);
-        updateCanvas(res);
-        displayImage();
-        break;
-      }
-      default:{
-        cout << "not implemented" << endl;
-      }
-    }
-}
-
-uint8_t _get_medium_color(priority_queue <int>& heap){
-    int size = (heap.size()-1)/2;
-    while (heap.size()>size) {
-        heap.pop();
-    }
-    return heap.top();
-}
-
-RGBA Canvas2D::getMedium(size_t centerIndex, int row, int col, int radius) {
-    RGBA medium_color;
-    priority_queue <int> red_heap;
-    priority_queue <int> green_heap;
-    priority_queue <int> blue_heap;
-    for (int r = -radius; r<=radius; r++) {
-        for (int c = -radius; c<=radius; c++) {
-            auto n_r = row+r;
-            auto n_c = col+r;
-            RGBA canvas_color;
-            if (n_r>=0 && n_r<m_height && n_c>=0 && n_c<m_width) {
-                canvas_color = m_data[n_r*m_width + n_c];
-            } else {
-                continue;
-            }
-            red_heap.push(canvas_color.r);
-            green_heap.push(canvas_color.g);
-            blue_heap.push(canvas_color.b);
-        }
+    if (m_filterJob) {
+        return;
     }
-    medium_color = {_get_medium_color(red_heap), _get_medium_color(green_heap), _get_medium_color(blue_heap), 255};
-    return medium_color;
-}
-
-vector<RGBA> Canvas2D::convolve2D_medium(std::vector<RGBA> &data, int radius) {
-    std::vector<RGBA> result(data.size());
-    for (int r = 0; r < m_height; r++) {
-        for (int c = 0; c < m_width; c++) {
-            size_t centerIndex = r * m_width + c;
-            RGBA medium_color = getMedium(centerIndex, r, c, radius);
-            result[centerIndex] = medium_color;
-         }
+    FilterGraph graph;
+    if (!graph.add(settings.filterType, settings)) {
+        cout << "not implemented" << endl;
+        return;
     }
-    return result;
-}
-
-
-inline std::uint8_t floatToUint8(float x) {
-    return round(x * 255.f);
-}
 
+    auto job = std::make_shared<JobControl>();
+    auto data = std::make_shared<std::vector<RGBA>>(m_data);
+    int width = m_width;
+    int height = m_height;
+    m_filterJob = job;
+    m_filterTimer.start();
+    emit filterProgress(0);
 
-float triangle(float x, float a) {
-    float r = a < 1 ? 1.0 / a : 1.0;
-    if ((x < -r) || (x > r)) {
-        return 0.0;
-    } else {
-        return (1.0 - fabs(x) / r) / r;
-    }
-}
-
-std::vector<RGBA> Canvas2D::getScaledImageY(std::vector<RGBA> &data, int input_width, int input_height, float scaleY, int output_width, int output_height) {
-    std::vector<RGBA> result(output_width*output_height);
-    float supportY = (scaleY > 1.0) ? 1.0 : 1.0 / scaleY;
-    float center;
-    int cur_idx;
-    for (int row = 0; row < output_height; row ++ ){
-        for (int col = 0; col < output_width; col ++ ){
-            float weights_sum = 0.0;
-            float center = row / scaleY + (1 - scaleY) / (2 * scaleY);
-            int left = ceil(center - supportY);
-            int right = floor(center + supportY);
-            float acc_r = 0.0;
-            float acc_g = 0.0;
-            float acc_b = 0.0;
-            for (int idx = left; idx <= right; idx ++) {
-                if (idx>=0 && idx<input_height) {
-                    cur_idx = idx*input_width+col;
-                    RGBA cur_color = data[cur_idx];
-                    weights_sum += triangle(idx - center, scaleY);
-                    acc_r += triangle(idx - center, scaleY) * (cur_color.r / 255.0);
-                    acc_b += triangle(idx - center, scaleY) * (cur_color.b / 255.0);
-                    acc_g += triangle(idx - center, scaleY) * (cur_color.g / 255.0);
-                }
-            }
-            auto n_r = floatToUint8(acc_r/weights_sum);
-            auto n_g = floatToUint8(acc_g/weights_sum);
-            auto n_b = floatToUint8(acc_b/weights_sum);
-            result[row * output_width + col] = RGBA{n_r, n_g, n_b, 255};
+    m_filterPool.start([=, this]() mutable {
+        {
+            JobScope scope(job.get());
+            graph.run(*data, width, height);
         }
-    }
-    return result;
-}
-
-std::vector<RGBA> Canvas2D::getScaledImageX(std::vector<RGBA> &data, int input_width, int input_height, float scaleX, int output_width, int output_height) {
-    std::vector<RGBA> result(output_width*output_height);
-    float supportX = (scaleX > 1.0) ? 1.0 : 1.0 / scaleX;
-    float center;
-    int cur_idx;
-    for (int row = 0; row < input_height; row ++ ){
-        for (int col = 0; col < output_width; col ++ ){
-            float weights_sum = 0.0;
-            float center = col / scaleX + (1 - scaleX) / (2 * scaleX);
-            int left = ceil(center - supportX);
-            int right = floor(center + supportX);
-            float acc_r = 0.0;
-            float acc_g = 0.0;
-            float acc_b = 0.0;
-            for (int idx = left; idx <= right; idx ++) {
-                if (idx>=0 && idx<input_width) {
-                    cur_idx = row*input_width+idx;
-                    RGBA cur_color = data[cur_idx];
-                    weights_sum += triangle(idx - center, scaleX);
-                    acc_r += triangle(idx - center, scaleX) * (cur_color.r / 255.0);
-                    acc_b += triangle(idx - center, scaleX) * (cur_color.b / 255.0);
-                    acc_g += triangle(idx - center, scaleX) * (cur_color.g / 255.0);
-                }
+        QMetaObject::invokeMethod(this, [=, this] {
+            if (job != m_filterJob) {
+                return;
             }
-            auto n_r = floatToUint8(acc_r/weights_sum);
-            auto n_g = floatToUint8(acc_g/weights_sum);
-            auto n_b = floatToUint8(acc_b/weights_sum);
-            result[row * output_width + col] = RGBA{n_r, n_g, n_b, 255};
-        }
-    }
-    return result;
-}
-
-
-std::uint8_t rgbaToGray(const RGBA &pixel) {
-    std::uint8_t intensity = 0.299*pixel.r + 0.587*pixel.g + 0.114*pixel.b;
-    return intensity;
+            m_filterJob.reset();
+            m_filterTimer.stop();
+            if (job->cancelled()) {
+                emit filterFinished(false);
+                return;
+            }
+            // swapped in on the UI thread, in one step
+            m_filterResult = std::move(*data);
+            m_filterWidth = width;
+            m_filterHeight = height;
+            m_filterPending = true;
+            if (!m_frameTimer.isActive()) {
+                adoptFilterResult();
+            }
+        }, Qt::QueuedConnection);
+    });
 }
 
-void Canvas2D::filterGray(std::vector<RGBA> &data) {
-    for (int i = 0; i<m_data.size(); i++) {
-        RGBA &currentPixel = m_data[i];
-
-        std::uint8_t gray_pixel = rgbaToGray(currentPixel);
-        currentPixel.r = gray_pixel;
-        currentPixel.g = gray_pixel;
-        currentPixel.b = gray_pixel;
+/**
+ * @brief Stops the background filter; its chunks that have not started are skipped
+ */
+void Canvas2D::cancelFilter() {
+    // a running job reports filterFinished(false) once its thread returns
+    if (m_filterJob) {
+        m_filterJob->cancel();
     }
-}
-
-vector<RGBA> Canvas2D::getEdgeMagnitude(std::vector<RGBA> &x, std::vector<RGBA> &y) {
-    float s = settings.edgeDetectSensitivity;
-    std::vector<RGBA> result(m_data.size());
-    for (int i = 0; i < m_data.size(); i++) {
-        float mag = s * sqrt(pow(x[i].r, 2) + pow(y[i].r, 2));
-        result[i].r = mag;
-        result[i].g = mag;
-        result[i].b = mag;
+    if (m_filterPending) {
+        m_filterPending = false;
+        m_filterResult = {};
+        emit filterFinished(false);
     }
-    return result;
 }
 
-
-void Canvas2D::updateCanvas(std::vector<RGBA> &target) {
-    for (int i = 0; i<m_data.size(); i++) {
-        m_data[i] = target[i];
-    }
+/**
+ * @brief Makes the finished filter result the current image
+ */
+void Canvas2D::adoptFilterResult() {
+    invalidatePreview();
+    m_filterPending = false;
+    m_data.swap(m_filterResult);
+    m_filterResult = {};
+    m_width = m_filterWidth;
+    m_height = m_filterHeight;
+    m_history.markAllDirty();
+    m_history.commit(m_data, m_width, m_height);
+    displayImage();
+    emit filterFinished(true);
 }
 
 
+/**
+ * @brief Called when any of the parameters in the UI are modified.
+ */
+void Canvas2D::settingsChanged() {
+    // this saves your UI settings locally to load next time you run the
+    // program; the write happens in the background once the changes settle
+    m_settingsStore.changed(settings);
 
-
-std::vector<float> Canvas2D::createBlurFilter() {
-    int size = settings.blurRadius*2 + 1;
-    std::vector<float> filter(size);
-    float sigma = settings.blurRadius / 3.0;
-    float norm = 0.0;
-    for(int i = 0; i < size; i++) {
-        float x = i - settings.blurRadius;
-        filter[i] = (1/(sqrt(2*M_PI*pow(sigma, 2)))) * (exp(-(pow(x,2) / (2 * pow(sigma, 2)))));
+    // 1. update brush
+    if (settings.brushType != prev_brush_type || settings.brushRadius != prev_brush_radius || settings.brushDensity != prev_density) {
+        prev_brush_type = settings.brushType;
+        prev_brush_radius = settings.brushRadius;
+        prev_density = settings.brushDensity;
+        updateBrush(settings);
     }
 
-    return filter;
-}
+    m_history.setBudget(size_t(settings.historyBudget) << 20);
+    m_history.setCompression(settings.historyCompression);
 
-RGBA Canvas2D::getPixelReflected(std::vector<RGBA> &data, int width, int height, int x, int y) {
-    int newX;
-    int newY;
-    if (x<0) {
-        newX = -x;
-    } else if (x>=width) {
-        newX = (width-1)-(x % width);
-    } else {
-        newX = x;
+    // a stroke in progress writes m_data, which the preview job reads, so a
+    // change made while dragging is picked up by mouseUp
+    if (!m_frameTimer.isActive()) {
+        syncPreview();
     }
+}
 
-    if (y<0) {
-        newY = -y;
-    } else if (y>=height) {
-        newY = (height-1)-(x % height);
-    } else {
-        newY = y;
+/**
+ * @brief Brings the preview in line with the settings: only the filter
+ * parameters change it, brush changes leave it be
+ */
+void Canvas2D::syncPreview() {
+    if (!settings.filterPreview) {
+        hidePreview();
+    } else if (!sameFilterSettings(settings, m_previewSettings)) {
+        updatePreview();
     }
-    return data[width * newY + newX];
+    m_previewSettings = settings;
 }
 
-std::vector<RGBA> Canvas2D::convolve2D(std::vector<RGBA> &data, std::vector<float> &filter, int filter_width, int filter_height, bool edge_flag) {
-    std::vector<RGBA> result(data.size());
-
-    for (int r = 0; r < m_height; r++) {
-        for (int c = 0; c < m_width; c++) {
-            size_t centerIndex = r * m_width + c;
-
-            float redAcc = 0;
-            float greenAcc = 0;
-            float blueAcc = 0;
-            float weights_sum = 0.0;
-
-            for (int row = filter_height-1; row>=0; row--) {
-                for (int col = filter_width-1; col>=0; col--) {
-                    RGBA canvas_color;
-                    int shift_row = filter_height/2-row;
-                    int shift_col = filter_width/2-col;
-
-                    int canvas_row = r+shift_row;
-                    int canvas_col = c+shift_col;
-
-                    if (canvas_row>=0 && canvas_row<m_height && canvas_col>=0 && canvas_col<m_width) {
-                        canvas_color = data[canvas_row*m_width + canvas_col];
-                    } else {
-                        canvas_color = getPixelReflected(data, m_width, m_height, canvas_col, canvas_row);
-                    }
-
-                    int filter_index = row*filter_width+col;
-
-                    weights_sum += filter[filter_index];
-
-                    redAcc += filter[filter_index] * canvas_color.r;
-                    greenAcc += filter[filter_index] * canvas_color.g;
-                    blueAcc += filter[filter_index] * canvas_color.b;
-                }
+/**
+ * @brief Re-runs the selected filter on the proxy level for the view, in the
+ * background; a newer call cancels the run before it. The pyramid is built
+ * by the job too when an edit has dropped it
+ */
+void Canvas2D::updatePreview() {
+    if (!FilterGraph().add(settings.filterType, settings)) {
+        hidePreview();
+        return;
+    }
+    // the shown preview stays up until the new one replaces it
+    if (m_previewJob) {
+        m_previewJob->cancel();
+        m_previewJob.reset();
+    }
+    m_previewPool.waitForDone();
+
+    auto job = std::make_shared<JobControl>();
+    m_previewJob = job;
+    std::shared_ptr<const ImagePyramid> cached = m_pyramid;
+    Settings current = settings;
+    QSize view = parentWidget() ? parentWidget()->size() : size();
+    int full_width = m_width;
+    int full_height = m_height;
+
+    m_previewPool.start([=, this] {
+        std::shared_ptr<const ImagePyramid> pyramid = cached;
+        std::shared_ptr<std::vector<RGBA>> data;
+        int level = 0;
+        int width = full_width;
+        int height = full_height;
+        {
+            JobScope scope(job.get());
+            if (!pyramid) {
+                // m_data does not change while this job runs (see canvas2d.h)
+                auto built = std::make_shared<ImagePyramid>();
+                built->build(m_data, full_width, full_height, 64, 64);
+                pyramid = built;
             }
-            if (edge_flag) {
-                redAcc = abs(redAcc) > 255 ? 255 : abs(redAcc);
-                greenAcc = abs(greenAcc) > 255 ? 255 : abs(greenAcc);
-                blueAcc = abs(blueAcc) > 255 ? 255 : abs(blueAcc);
-                result[centerIndex] = RGBA{floatToUint8(redAcc/255), floatToUint8(greenAcc/255), floatToUint8(blueAcc/255), 255};
-            } else {
-                result[centerIndex] = RGBA{floatToUint8(redAcc/255/weights_sum), floatToUint8(greenAcc/255/weights_sum), floatToUint8(blueAcc/255/weights_sum), 255};
+            // the smallest level still covering the view
+            while (level < pyramid->levels() && pyramid->width(level + 1) >= view.width()
+                   && pyramid->height(level + 1) >= view.height()) {
+                level++;
             }
-         }
-    }
-    return result;
-}
-
-float _gaussian(float x, double sigma) {
-    return (1/(sqrt(2*M_PI*pow(sigma, 2)))) * (exp(-(pow(x,2) / (2 * pow(sigma, 2)))));
-}
-
-float _distance(int r, int c, int n_r, int n_c) {
-    return sqrt(pow(r - n_r, 2) + pow(c - n_c, 2));
-}
-
-void Canvas2D::apply_bilateral(vector<RGBA> &m_data, vector<RGBA> &result, int row, int col, double sigma_s, double sigma_r, int radius) {
-    float acc_red = 0;
-    float acc_green = 0;
-    float acc_blue = 0;
-    float Wp_r = 0;
-    float Wp_g = 0;
-    float Wp_b = 0;
-
-    int origin_idx = row*m_width+col;
-
-    for (int r = -radius; r<=radius; r++) {
-        for (int c = -radius; c<=radius; c++) {
-            int n_r = row+r;
-            int n_c = col+c;
-
-            if (!(n_r>=0 && n_r<m_height && n_c>=0 && n_c<m_width)) {
-                continue;
+            data = std::make_shared<std::vector<RGBA>>(level > 0 ? pyramid->pixels(level) : m_data);
+            if (level > 0) {
+                width = pyramid->width(level);
+                height = pyramid->height(level);
             }
-            int cur_idx = n_r*m_width+n_c;
-
-            auto space_gaussian = _gaussian(_distance(row, col, n_r, n_c), sigma_s);
-            auto range_gaussian_r = _gaussian(m_data[origin_idx].r/255.0-m_data[cur_idx].r/255.0, sigma_r);
-            auto range_gaussian_g = _gaussian(m_data[origin_idx].g/255.0-m_data[cur_idx].g/255.0, sigma_r);
-            auto range_gaussian_b = _gaussian(m_data[origin_idx].b/255.0-m_data[cur_idx].b/255.0, sigma_r);
 
-            acc_red += (m_data[cur_idx].r/255.0)*(space_gaussian*range_gaussian_r);
-            acc_blue += (m_data[cur_idx].b/255.0)*(space_gaussian*range_gaussian_b);
-            acc_green += (m_data[cur_idx].g/255.0)*(space_gaussian*range_gaussian_g);
-
-            Wp_r += space_gaussian*range_gaussian_r;
-            Wp_g += space_gaussian*range_gaussian_g;
-            Wp_b += space_gaussian*range_gaussian_b;
+            Settings proxy = proxySettings(current, level);
+            FilterGraph graph;
+            graph.add(proxy.filterType, proxy);
+            graph.run(*data, width, height);
         }
-    }
+        int proxy_width = level > 0 ? pyramid->width(level) : full_width;
+        int proxy_height = level > 0 ? pyramid->height(level) : full_height;
 
-    acc_red /= Wp_r;
-    acc_green /= Wp_g;
-    acc_blue /= Wp_b;
-    result[origin_idx] = {float2int(acc_red), float2int(acc_green), float2int(acc_blue), 255};
+        QMetaObject::invokeMethod(this, [=, this] {
+            if (job != m_previewJob || job->cancelled()) {
+                return;
+            }
+            m_previewJob.reset();
+            m_pyramid = pyramid;
+            m_previewPixels = data;
+            m_preview = QImage(reinterpret_cast<const uchar*>(data->data()), width, height, 4*width, QImage::Format_RGBX8888);
+            // shown at the size the full-resolution result would have
+            setFixedSize(std::max(1, int(std::lround(double(m_width) * width / proxy_width))),
+                         std::max(1, int(std::lround(double(m_height) * height / proxy_height))));
+            update();
+        }, Qt::QueuedConnection);
+    });
 }
 
-std::vector<RGBA> Canvas2D::convolve2D_bilateral(std::vector<RGBA> &data, int radius, double sigma_s, double sigma_r) {
-    std::vector<RGBA> result(data.size());
-
-    for (int r = 0; r < m_height; r++) {
-        for (int c = 0; c < m_width; c++) {
-            apply_bilateral(m_data, result, r, c, sigma_s, sigma_r, radius);
-         }
+/**
+ * @brief Back to showing the image itself; stops the preview job and waits
+ * for it, which takes at most one chunk of its work once cancelled
+ */
+void Canvas2D::hidePreview() {
+    if (m_previewJob) {
+        m_previewJob->cancel();
+        m_previewJob.reset();
+    }
+    m_previewPool.waitForDone();
+    if (!m_preview.isNull()) {
+        m_preview = QImage();
+        m_previewPixels.reset();
+        setFixedSize(m_width, m_height);
+        update();
     }
-    return result;
 }
 
-
-
 /**
- * @brief Called when any of the parameters in the UI are modified.
+ * @brief Called before m_data changes: the preview job must not read it any
+ * more and the pyramid built from it is stale
  */
-void Canvas2D::settingsChanged() {
-    // this saves your UI settings locally to load next time you run the program
-    settings.saveSettings();
-
-    // 1. update brush
-    if (settings.brushType != prev_brush_type || settings.brushRadius != prev_brush_radius || settings.brushDensity != prev_density) {
-        prev_brush_type = settings.brushType;
-        prev_brush_radius = settings.brushRadius;
-        prev_density = settings.brushDensity;
-        updateBrush(settings);
-    }
+void Canvas2D::invalidatePreview() {
+    hidePreview();
+    m_pyramid.reset();
 }
 
 /**
  * @brief These functions are called when the mouse is clicked and dragged on the canvas
  */
 void Canvas2D::mouseDown(int x, int y) {
-    if (settings.brushType == BRUSH_SMUDGE) {
-        formPrevColor(x, y);
-    }
-    if (settings.brushType == BRUSH_FILL) {
-        RGBA target_color = m_data[pos2index(x, y, m_width)];
-        fillBucket(x, y, target_color);
-    }
+    // edits are made (and shown) on the image itself
+    invalidatePreview();
     if (settings.brushType == BRUSH_COLOR_PICKER) {
         pickColor(x, y);
         return;
     }
+    if (settings.brushType == BRUSH_FILL) {
+        fillBucket(x, y);
+        displayDirty();
+        return;
+    }
     if (settings.brushType == BRUSH_ERASER_CONNECTED) {
         eraserConnected(x, y);
-        displayImage();
+        displayDirty();
         return;
     }
 
+    // the other brushes stamp along the drag; the frame timer running is
+    // what marks a stroke in progress
+    m_stroke.begin(x, y, Stroke::spacingFor(settings.brushRadius));
+    m_frameTimer.start();
+    m_strokeIndex++;
+    m_stampIndex = 0;
+    m_strokeFixAlpha = settings.fixAlphaBlending;
+    if (m_strokeFixAlpha) {
+        m_alphaStroke.begin(m_width, m_height);
+    }
+    if (settings.brushType == BRUSH_SMUDGE) {
+        formPrevColor(x, y);
+    }
+
     drawStamp(x-settings.brushRadius, y-settings.brushRadius);
-    displayImage();
+    displayDirty();
 }
 
 void Canvas2D::mouseDragged(int x, int y) {
-    drawStamp(x-settings.brushRadius, y-settings.brushRadius);
-    if (settings.brushType == BRUSH_SMUDGE) {
-        formPrevColor(x, y);
+    // only queue the stamps here, rasterizeStroke draws them on the next frame
+    if (m_frameTimer.isActive()) {
+        m_stroke.moveTo(x, y);
     }
-    displayImage();
 }
 
 void Canvas2D::mouseUp(int x, int y) {
-    if (prev_canvas.size() >= max_depth) {
-        prev_canvas.pop_back();
+    if (m_frameTimer.isActive()) {
+        m_stroke.moveTo(x, y);
+        m_frameTimer.stop();
+        stampStroke(m_stroke.pending());
+        displayDirty();
+        if (m_strokeFixAlpha) {
+            m_alphaStroke.end();
+            m_strokeFixAlpha = false;
+        }
     }
-    prev_canvas.push_front(m_data);
-}
-
-//helper functions
-int Canvas2D::pos2index(int x, int y, int width) {
-    return y*width+x;
-}
-
-std::vector<int> Canvas2D::index2pos(int index, int width) {
-    int row = index / width;
-    int col = index % width;
-    std::vector<int> res{ col, row };
-    return res;
+    // only the tiles touched since mouseDown are copied into the history
+    m_history.commit(m_data, m_width, m_height);
+    // a load finished during the stroke replaces any filter result as well
+    if (m_loadPending) {
+        adoptLoadedImage();
+    } else if (m_filterPending) {
+        adoptFilterResult();
+    }
+    // filter changes made during the stroke
+    syncPreview();
 }
 
-
-uint8_t Canvas2D::float2int(float intensity) {
-    uint8_t res = round(intensity * 255);
-    return res;
+/**
+ * @brief Draws the stamps queued since the last frame and repaints once.
+ * Each frame draws at most STROKE_PIXELS_PER_FRAME brush pixels, the rest
+ * waits for the next frame (or mouseUp), so fast input cannot stall the UI.
+ */
+void Canvas2D::rasterizeStroke() {
+    int size = 2*settings.brushRadius+1;
+    stampStroke(std::max(1, STROKE_PIXELS_PER_FRAME / (size*size)));
+    displayDirty();
 }
 
-float Canvas2D::int2float(uint8_t intensity) {
-    float res = intensity/255.0;
-    return res;
+void Canvas2D::stampStroke(size_t max_stamps) {
+    m_stroke.rasterize(max_stamps, [this](int x, int y) {
+        drawStamp(x-settings.brushRadius, y-settings.brushRadius);
+        if (settings.brushType == BRUSH_SMUDGE) {
+            m_smudge.pickUp(m_data, m_width, m_height, x, y, settings.smudgeStrength);
+        }
+    });
 }
 
-auto Canvas2D::getBrushDistance(int current, int center) {
-    int r = settings.brushRadius;
-    std::vector<int> cur_pos = index2pos(current, 2*r+1);
-    std::vector<int> center_pos = index2pos(center, 2*r+1);
-    auto distance = round(sqrt(pow((cur_pos[0]-center_pos[0]), 2)+pow((cur_pos[1]-center_pos[1]), 2)));
-    return distance;
+//helper functions
+int Canvas2D::pos2index(int x, int y, int width) {
+    return y*width+x;
 }
 
 void Canvas2D::formPrevColor(int col, int row) {
-    int color_mask_size = (2*settings.brushRadius+1)*(2*settings.brushRadius+1);
-    prev_color.assign(color_mask_size, RGBA{0,0,0,0});
-    int r = settings.brushRadius;
-    int cnt = 0;
-    int start_row = row - r;
-    int end_row = row + r + 1;
-    int start_col = col - r;
-    int end_col = col + r + 1;
-
-    for (int i = start_row; i < end_row; i++){
-        for (int j = start_col; j < end_col; j++){
-            if (0<=i && i<m_height && 0<=j && j<m_width) {
-                prev_color[cnt] = m_data[pos2index(j, i, m_width)];
-            }
-            cnt += 1;
-        }
-    }
+    m_smudge.begin(m_data, m_width, m_height, settings.brushRadius, col, row);
 }
 
 void Canvas2D::updateBrush(Settings settings) {
-    int brush_size = (2*settings.brushRadius+1)*(2*settings.brushRadius+1);
-    brush.assign(brush_size, 0);
-
-    int center = (brush_size-1)/2;
-    int r = settings.brushRadius;
-
-    switch (settings.brushType) {
-      case BRUSH_CONSTANT:
-        for (int i = 0; i<brush_size; i++){
-            auto distance = getBrushDistance(i, center);
-            if (distance <= r) {
-                brush[i] = 1;
-            }
-        }
-        break;
-      case BRUSH_LINEAR:
-        for (int i = 0; i<brush_size; i++){
-            auto distance = getBrushDistance(i, center);
-            if (distance <= r) {
-                brush[i] = std::max(0.0, 1-distance/r);
-            }
-        }
-        break;
-      case BRUSH_QUADRATIC:
-        // C = 1; B = -2/r; A = 1/r^2
-        for (int i = 0; i<brush_size; i++){
-            auto distance = getBrushDistance(i, center);
-            if (distance <= r) {
-                brush[i] = std::max(0.0,(1.0/(r*r))*pow(distance,2)-2.0/r*distance+1);
-            }
-        }
-        break;
-      case BRUSH_SMUDGE:
-        for (int i = 0; i<brush_size; i++){
-            auto distance = getBrushDistance(i, center);
-            if (distance <= r) {
-                brush[i] = std::max(0.0,(1.0/(r*r))*pow(distance,2)-2.0/r*distance+1);
-            }
-        }
-        break;
-      case BRUSH_SPRAY:
-        for (int i = 0; i<brush_size; i++){
-            auto distance = getBrushDistance(i, center);
-            if (distance <= r) {
-                brush[i] = 1;
-            }
-        }
-        break;
-      case BRUSH_ERASER:
-        for (int i = 0; i<brush_size; i++){
-            auto distance = getBrushDistance(i, center);
-            if (distance <= r) {
-                brush[i] = 1;
-            }
-        }
-        break;
-      case BRUSH_ERASER_CONNECTED:
-        break;
-      default:
-        std::cout << "INVALID BRUSH TYPE";
-    }
-
+    brush = createBrushMask(settings.brushType, settings.brushRadius);
 }
 
 void Canvas2D::drawStamp(int start_col, int start_row) {
-    int row = settings.brushRadius*2+1;
-    int col = settings.brushRadius*2+1;
-    int cnt = 0;
-    uint8_t r = settings.brushColor.r;
-    uint8_t g = settings.brushColor.g;
-    uint8_t b = settings.brushColor.b;
-    float a = int2float(settings.brushColor.a);
-
-    for (int i=0; i<row; i++) {
-        for (int j=0; j<col; j++){
-            int cur_row = i+start_row;
-            int cur_col = j+start_col;
-            float brush_intensity = brush[cnt];
-            if (0<=cur_row && cur_row<m_height && 0<=cur_col && cur_col<m_width) {
-                int canvas_idx = pos2index(cur_col, cur_row, m_width);
-                if (settings.brushType == BRUSH_SMUDGE) {
-                    r = prev_color[cnt].r;
-                    g = prev_color[cnt].g;
-                    b = prev_color[cnt].b;
-                    a = 1.0;
-                }
-                if (settings.brushType == BRUSH_SPRAY) {
-                    bool hit = (rand() % 100) > settings.brushDensity/6;
-                    if (hit) {
-                        brush_intensity = 0;
-                    }
-                }
-                if (settings.brushType == BRUSH_ERASER) {
-                    r = init_color.r;
-                    g = init_color.g;
-                    b = init_color.b;
-                    a = 1.0;
-                }
-
-                // change red
-                m_data[canvas_idx].r = 0.5 + a * r * brush_intensity + m_data[canvas_idx].r * (1-brush_intensity*a);
-                // change green
-                m_data[canvas_idx].g = 0.5 + a * g * brush_intensity + m_data[canvas_idx].g * (1-brush_intensity*a);
-                // change blue
-                m_data[canvas_idx].b = 0.5 + a * b * brush_intensity + m_data[canvas_idx].b * (1-brush_intensity*a);
-            }
-            cnt += 1;
-        }
-    }
-
+    // the spray pattern is a function of (stroke, stamp), so strokes replay identically
+    std::uint64_t seed = (m_strokeIndex << 32) | m_stampIndex++;
+    ::drawStamp(m_data, m_width, m_height, *brush, m_smudge.colors(), settings, init_color, start_col, start_row,
+                m_strokeFixAlpha ? &m_alphaStroke : nullptr, seed);
+    int size = brush->size;
+    m_history.markDirty(start_col, start_row, start_col+size, start_row+size);
+    m_dirty |= QRect(start_col, start_row, size, size);
 }
 
-
-bool _check_color(RGBA color1, RGBA color2) {
-    if (color1.r == color2.r && color1.g == color2.g && color1.b == color2.b && color1.a == color2.a) {
-        return true;
-    }
-    return false;
-};
-
-
-void Canvas2D::fillBucket(int col, int row, RGBA target_color) {
-    queue<vector<int>> q;
-    vector<vector<int>> v(m_height,vector<int>(m_width,0));
-    q.push({row, col});
-
-    int dir_row[4] = {0,1,0,-1};
-    int dir_col[4] = {1,0,-1,0};
-    while (q.size()) {
-        int cur_row = q.front()[0];
-        int cur_col = q.front()[1];
-        int cur_idx = pos2index(cur_col, cur_row, m_width);
-        q.pop();
-        RGBA cur_color = m_data[cur_idx];
-        if (_check_color(cur_color, target_color)) {
-            m_data[cur_idx] = settings.brushColor;
-            for (int i=0;i<4;i++) {
-                int nr=cur_row+dir_row[i],nc=cur_col+dir_col[i];
-                if (nr>=0 && nc>=0 && nr!=m_height && nc!=m_width && v[nr][nc]==0) {
-                    v[nr][nc]=1;
-                    q.push({nr,nc});
-                }
-            }
-        }
-    }
+void Canvas2D::fillBucket(int col, int row) {
+    FillRegion region = ::fillBucket(m_fill, m_data, m_width, m_height, col, row, settings.brushColor,
+                                     settings.fillTolerance, settings.fillEightConnected);
+    markFilled(region);
 }
 
 void Canvas2D::pickColor(int col, int row) {
@@ -732,28 +584,16 @@ void Canvas2D::pickColor(int col, int row) {
 }
 
 void Canvas2D::eraserConnected(int col, int row) {
-    queue<vector<int>> q;
-    vector<vector<int>> v(m_height,vector<int>(m_width,0));
-    q.push({row, col});
-
-    int dir_row[4] = {0,1,0,-1};
-    int dir_col[4] = {1,0,-1,0};
-    while (q.size()) {
-        int cur_row = q.front()[0];
-        int cur_col = q.front()[1];
-        int cur_idx = pos2index(cur_col, cur_row, m_width);
-        q.pop();
-        RGBA cur_color = m_data[cur_idx];
-        if (!_check_color(cur_color, init_color)) {
-            m_data[cur_idx] = init_color;
-            for (int i=0;i<4;i++) {
-                int nr=cur_row+dir_row[i],nc=cur_col+dir_col[i];
-                if (nr>=0 && nc>=0 && nr!=m_height && nc!=m_width && v[nr][nc]==0) {
-                    v[nr][nc]=1;
-                    q.push({nr,nc});
-                }
-            }
-        }
-    }
+    FillRegion region = ::eraserConnected(m_fill, m_data, m_width, m_height, col, row, init_color,
+                                          settings.fillEightConnected);
+    markFilled(region);
 }
 
+// only the bounding box of a fill goes into the history and gets repainted
+void Canvas2D::markFilled(const FillRegion &region) {
+    if (region.pixels == 0) {
+        return;
+    }
+    m_history.markDirty(region.x0, region.y0, region.x1, region.y1);
+    m_dirty |= QRect(region.x0, region.y0, region.x1 - region.x0, region.y1 - region.y0);
+}
@@ -2,44 +2,125 @@
 #define CANVAS2D_H
 
 #include <QLabel>
+#include <QImage>
 #include <QMouseEvent>
+#include <QThreadPool>
+#include <QTimer>
 #include <array>
 #include "rgba.h"
 #include "settings.h"
-#include <deque>
+#include "settingsstore.h"
+#include "brush.h"
+#include "floodfill.h"
+#include "history.h"
+#include "parallel.h"
+#include "preview.h"
+#include "stroke.h"
 
 class Canvas2D : public QLabel {
     Q_OBJECT
 public:
+    ~Canvas2D();
+
     int m_width = 0;
     int m_height = 0;
     int prev_brush_type;
     int prev_brush_radius;
     int prev_density;
-    int max_depth = 5;
     RGBA init_color = RGBA{255, 255, 255, 255};
-    std::deque<std::vector<RGBA>> prev_canvas;
 
     void init();
     void clearCanvas();
-    bool loadImageFromFile(const QString &file);
+    // decodes `file` on a worker thread; the canvas switches to it when done
+    void loadImageFromFile(const QString &file);
+    // back to settings.imagePath as loaded, from memory when it is cached
+    void revertImage();
     void displayImage();
-    void myDisplayImage(std::vector<RGBA> &data, int width, int height);
+    void displayDirty();
     void resize(int w, int h);
 
     // This will be called when the settings have changed
     void settingsChanged();
 
     // Filter TODO: implement
+    // runs the selected filter on a copy of the image in the background; the
+    // result replaces the image when it is done (after the stroke in progress)
     void filterImage();
+    void cancelFilter();
+    bool filterRunning() const { return m_filterJob != nullptr; }
 
     // My Fun Part Exploration
     void prevCanvas();
+    void nextCanvas();
 
 private:
     std::vector<RGBA> m_data;
-    std::vector<float> brush;
-    std::vector<RGBA> prev_color;
+    History m_history;
+    // settings are loaded before the canvas is created
+    SettingsStore m_settingsStore{settings};
+
+    // the last image loaded, kept for revert; loads finishing after a
+    // newer one was started (m_loadIndex) are dropped
+    std::shared_ptr<const std::vector<RGBA>> m_original;
+    QString m_originalPath;
+    int m_originalWidth = 0;
+    int m_originalHeight = 0;
+    int m_loadIndex = 0;
+    // a loaded image waiting for the stroke in progress to end
+    bool m_loadPending = false;
+    std::vector<RGBA> m_loadResult;
+    std::shared_ptr<const std::vector<RGBA>> m_loadOriginal;
+    QString m_loadPath;
+    int m_loadWidth = 0;
+    int m_loadHeight = 0;
+    void adoptLoadedImage();
+
+    // the filter running in the background and the timer polling its progress
+    std::shared_ptr<JobControl> m_filterJob;
+    QThreadPool m_filterPool;
+    QTimer m_filterTimer;
+    // a finished filter result waiting for the stroke in progress to end
+    bool m_filterPending = false;
+    std::vector<RGBA> m_filterResult;
+    int m_filterWidth = 0;
+    int m_filterHeight = 0;
+    void adoptFilterResult();
+
+    // live preview: the selected filter run on a pyramid level about the
+    // size of the view, drawn scaled up over the canvas until the next edit.
+    // The job builds the pyramid from m_data, so no job may run while m_data
+    // changes: edits call invalidatePreview() first, and no job is started
+    // during a stroke (settingsChanged leaves that to mouseUp)
+    std::shared_ptr<const ImagePyramid> m_pyramid;
+    std::shared_ptr<JobControl> m_previewJob;
+    QThreadPool m_previewPool;
+    Settings m_previewSettings = {};
+    std::shared_ptr<const std::vector<RGBA>> m_previewPixels;
+    QImage m_preview;
+    void syncPreview();
+    void updatePreview();
+    void hidePreview();
+    void invalidatePreview();
+    FloodFill m_fill;
+
+    // the stroke in progress and the timer that draws it frame by frame
+    static constexpr int STROKE_PIXELS_PER_FRAME = 1 << 20;
+    Stroke m_stroke;
+    AlphaStroke m_alphaStroke;
+    bool m_strokeFixAlpha = false; // fixAlphaBlending as of mouseDown, for the whole stroke
+    std::uint64_t m_strokeIndex = 0;
+    std::uint64_t m_stampIndex = 0;
+    QTimer m_frameTimer;
+    void rasterizeStroke();
+    void stampStroke(size_t max_stamps);
+
+    // m_data as seen by Qt (no copy) and the part of it not yet repainted
+    QImage m_image;
+    QRect m_dirty;
+    void wrapImage();
+    virtual void paintEvent(QPaintEvent *event) override;
+    std::shared_ptr<const BrushMask> brush;
+    SmudgeBuffer m_smudge;
 
     void mouseDown(int x, int y);
     void mouseDragged(int x, int y);
@@ -64,41 +145,26 @@ private:
 
     // helper function - Brush
     int pos2index(int x, int y, int width);
-    std::vector<int> index2pos(int index, int width);
-    uint8_t float2int(float intensity);
-    float int2float(uint8_t intensity);
     // basic brush-related function
     void updateBrush(Settings settings);
-    auto getBrushDistance(int current, int center);
     void drawStamp(int start_col, int start_row);
     // smudge brush
     void formPrevColor(int col, int row);
     // fill bucket
-    void fillBucket(int col, int row, RGBA target_color);
+    void fillBucket(int col, int row);
+    void markFilled(const FillRegion &region);
     // my fun exploration
     void pickColor(int col, int row);
     void eraserConnected(int col, int row);
 
-    // helper function - Filter
-    std::vector<float> createBlurFilter();
-
-    std::vector<RGBA> getEdgeMagnitude(std::vector<RGBA> &x, std::vector<RGBA> &y);
-    std::vector<RGBA> getScaledImageX(std::vector<RGBA> &data, int input_width, int input_height, float scaleX, int output_width, int output_height);
-    std::vector<RGBA> getScaledImageY(std::vector<RGBA> &data, int input_width, int input_height, float scaleY, int output_width, int output_height);
-
-    std::vector<RGBA> convolve2D(std::vector<RGBA> &data, std::vector<float> &filter, int filter_width, int filter_height, bool edge_flag);
-
-    void updateCanvas(std::vector<RGBA> &data);
-    void filterGray(std::vector<RGBA> &data);
-    RGBA getPixelReflected(std::vector<RGBA> &data, int width, int height, int x, int y);
-
-    // Extra Credit - Filter
-    std::vector<RGBA> convolve2D_medium(std::vector<RGBA> &data, int radius);
-    RGBA getMedium(size_t centerIndex, int row, int col, int radius);
-    std::vector<RGBA> convolve2D_bilateral(std::vector<RGBA> &data, int radius, double sigma_s, double sigma_r);
-    void apply_bilateral(std::vector<RGBA> &m_data, std::vector<RGBA> &result, int row, int col, double sigma_s, double sigma_r, int radius);
 signals:
     void pickColorChanged(int val);
+    // percentage of the file decoded so far, then whether it worked
+    void loadProgress(int percent);
+    void loadFinished(bool ok);
+    // same for a background filter; `applied` is false if it was cancelled
+    void filterProgress(int percent);
+    void filterFinished(bool applied);
 };
 
 #endif // CANVAS2D_H
@@ -0,0 +1,137 @@
+#include "chromatic.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr int CHUNK = 256;
+
+// source position of one channel of output pixel (ox, oy), clamped to the image
+void samplePosition(int width, int height, float lambda, int ox, int oy, float &sx, float &sy) {
+    float dx = ox + 0.5f - width / 2.f;
+    float dy = oy + 0.5f - height / 2.f;
+    float k = 1 + lambda * (dx * dx + dy * dy);
+    sx = std::clamp(width / 2.f + dx * k - 0.5f, 0.f, float(width - 1));
+    sy = std::clamp(height / 2.f + dy * k - 0.5f, 0.f, float(height - 1));
+}
+
+} // namespace
+
+void chromaticAberration(const std::vector<RGBA> &data, int width, int height,
+                         const std::array<float, 3> &lambda, std::vector<RGBA> &result) {
+    chromaticImageRect(data, 0, 0, width, height, width, height, lambda, 0, 0, width, height, result);
+}
+
+void chromaticSourceRect(int width, int height, const std::array<float, 3> &lambda, int x, int y, int w, int h,
+                         int &src_x, int &src_y, int &src_w, int &src_h) {
+    // for lambda >= 0 the warp is one-to-one, so the rectangle's border
+    // bounds where its pixels come from; otherwise every pixel is checked
+    bool fold = std::any_of(lambda.begin(), lambda.end(), [](float l) { return l < 0; });
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    for (int oy = y; oy < y + h; oy++) {
+        int step = (fold || oy == y || oy == y + h - 1) ? 1 : std::max(1, w - 1);
+        for (int ox = x; ox < x + w; ox += step) {
+            for (float l : lambda) {
+                float sx, sy;
+                samplePosition(width, height, l, ox, oy, sx, sy);
+                min_x = std::min(min_x, sx);
+                min_y = std::min(min_y, sy);
+                max_x = std::max(max_x, sx);
+                max_y = std::max(max_y, sy);
+            }
+        }
+    }
+    // bilinear sampling reads one pixel further right and down, plus a pixel of slack
+    src_x = std::max(0, int(min_x) - 1);
+    src_y = std::max(0, int(min_y) - 1);
+    src_w = std::min(width, int(max_x) + 3) - src_x;
+    src_h = std::min(height, int(max_y) + 3) - src_y;
+}
+
+void chromaticImageRect(const std::vector<RGBA> &rect, int src_x, int src_y, int src_w, int src_h,
+                        int width, int height, const std::array<float, 3> &lambda,
+                        int x, int y, int w, int h, std::vector<RGBA> &result) {
+    result.resize(size_t(w) * h);
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+
+    // offsets of the output columns from the center and their squares,
+    // padded to whole groups of four (CHUNK is a multiple of four)
+    int padded = (w + 3) & ~3;
+    std::vector<float> dx(padded), dx2(padded);
+    for (int i = 0; i < padded; i++) {
+        dx[i] = x + i + 0.5f - width / 2.f;
+        dx2[i] = dx[i] * dx[i];
+    }
+    const std::uint8_t *bytes = reinterpret_cast<const std::uint8_t*>(rect.data());
+
+    parallelFor(0, h, 8, [&](int begin, int end) {
+        // the row is done CHUNK columns at a time so the positions stay in L1
+        float sx[CHUNK], sy[CHUNK];
+        for (int oy = begin; oy < end; oy++) {
+            float dy = y + oy + 0.5f - height / 2.f;
+            float dy2 = dy * dy;
+            RGBA *out = &result[size_t(oy) * w];
+            for (int first = 0; first < w; first += CHUNK) {
+                int n = std::min(CHUNK, w - first);
+                for (int c = 0; c < 3; c++) {
+                    const float *cdx = &dx[first];
+                    const float *cdx2 = &dx2[first];
+#if defined(__SSE2__)
+                    __m128 l = _mm_set1_ps(lambda[c]);
+                    __m128 vdy = _mm_set1_ps(dy);
+                    __m128 vdy2 = _mm_set1_ps(dy2);
+                    __m128 one = _mm_set1_ps(1.f);
+                    __m128 cx = _mm_set1_ps(width / 2.f - 0.5f);
+                    __m128 cy = _mm_set1_ps(height / 2.f - 0.5f);
+                    __m128 zero = _mm_setzero_ps();
+                    __m128 max_x = _mm_set1_ps(float(width - 1));
+                    __m128 max_y = _mm_set1_ps(float(height - 1));
+                    for (int i = 0; i < n; i += 4) {
+                        __m128 k = _mm_add_ps(one, _mm_mul_ps(l, _mm_add_ps(_mm_loadu_ps(cdx2 + i), vdy2)));
+                        __m128 px = _mm_add_ps(cx, _mm_mul_ps(_mm_loadu_ps(cdx + i), k));
+                        __m128 py = _mm_add_ps(cy, _mm_mul_ps(vdy, k));
+                        _mm_storeu_ps(sx + i, _mm_min_ps(_mm_max_ps(px, zero), max_x));
+                        _mm_storeu_ps(sy + i, _mm_min_ps(_mm_max_ps(py, zero), max_y));
+                    }
+#else
+                    for (int i = 0; i < n; i++) {
+                        float k = 1 + lambda[c] * (cdx2[i] + dy2);
+                        sx[i] = std::clamp(width / 2.f - 0.5f + cdx[i] * k, 0.f, float(width - 1));
+                        sy[i] = std::clamp(height / 2.f - 0.5f + dy * k, 0.f, float(height - 1));
+                    }
+#endif
+                    // the blend stays scalar: SSE2 has no gather, and loading
+                    // the four neighbours of four pixels one by one into
+                    // float4s was slower than blending them where they are
+                    std::uint8_t *dst = reinterpret_cast<std::uint8_t*>(out + first) + c;
+                    for (int i = 0; i < n; i++) {
+                        // positions are clamped to the image, so truncation is floor
+                        int ix = int(sx[i]);
+                        int iy = int(sy[i]);
+                        float fx = sx[i] - ix;
+                        float fy = sy[i] - iy;
+                        // the right and lower neighbours, unless past the
+                        // rectangle (which only ends early at the image border)
+                        int step_x = ix + 1 < src_x + src_w ? 4 : 0;
+                        std::ptrdiff_t step_y = iy + 1 < src_y + src_h ? 4 * std::ptrdiff_t(src_w) : 0;
+                        const std::uint8_t *p = bytes + 4 * (std::ptrdiff_t(iy - src_y) * src_w + (ix - src_x)) + c;
+                        const std::uint8_t *q = p + step_y;
+                        float top = p[0] + fx * (p[step_x] - p[0]);
+                        float bottom = q[0] + fx * (q[step_x] - q[0]);
+                        dst[4 * i] = std::uint8_t(top + fy * (bottom - top) + 0.5f);
+                    }
+                }
+                for (int i = first; i < first + n; i++) {
+                    out[i].a = 255;
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,36 @@
+#ifndef CHROMATIC_H
+#define CHROMATIC_H
+
+#include <array>
+#include <vector>
+#include "rgba.h"
+
+/**
+ * @file    chromatic.h
+ *
+ * Chromatic aberration used by FILTER_CHROMATIC: each color channel is
+ * magnified about the image center by its own radial factor 1 + lambda r^2
+ * (r in pixels), so red, green and blue drift apart towards the corners.
+ * All three channels are resampled in one pass over the output. The
+ * horizontal offsets from the center and their squares are tabulated per
+ * column, the sample positions of four pixels are computed at a time with
+ * SSE2, and each channel is then sampled bilinearly (scalar), clamped at
+ * the border.
+ */
+
+// warps each channel of `data` by 1 + lambda[c] r^2 (r, g, b) into `result`
+// (same size, opaque, must not be `data`)
+void chromaticAberration(const std::vector<RGBA> &data, int width, int height,
+                         const std::array<float, 3> &lambda, std::vector<RGBA> &result);
+
+// the same warp for the output rectangle (x, y, w, h) only, for images
+// processed in tiles. chromaticSourceRect gives the source rectangle those
+// output pixels read (within the image); chromaticImageRect takes exactly
+// that rectangle in `rect` and writes w x h pixels to `result`
+void chromaticSourceRect(int width, int height, const std::array<float, 3> &lambda, int x, int y, int w, int h,
+                         int &src_x, int &src_y, int &src_w, int &src_h);
+void chromaticImageRect(const std::vector<RGBA> &rect, int src_x, int src_y, int src_w, int src_h,
+                        int width, int height, const std::array<float, 3> &lambda,
+                        int x, int y, int w, int h, std::vector<RGBA> &result);
+
+#endif // CHROMATIC_H
@@ -0,0 +1,110 @@
+#include "edge.h"
+#include "blur.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// gray row y with one reflected pixel on each side: out[0] is x = -1
+void grayRow(const std::vector<RGBA> &data, int width, int y, std::uint8_t *out) {
+    const RGBA *src = &data[size_t(y) * width];
+    for (int x = 0; x < width; x++) {
+        out[x + 1] = luminance(src[x]);
+    }
+    out[0] = out[reflectIndex(-1, width) + 1];
+    out[width + 1] = out[reflectIndex(width, width) + 1];
+}
+
+} // namespace
+
+void sobelEdges(const std::vector<RGBA> &data, int width, int height, float sensitivity, int magnitude, std::vector<RGBA> &result) {
+    result.resize(data.size());
+    if (width == 0 || height == 0) {
+        return;
+    }
+    // sensitivity in 1/256 steps for the integer magnitudes
+    int gain = std::lround(sensitivity * 256);
+
+    parallelFor(0, height, 16, [&](int begin, int end) {
+        int stride = width + 2;
+        std::vector<std::uint8_t> rows(3 * stride);
+        std::vector<std::int16_t> gx(width), gy(width);
+        std::uint8_t *up = &rows[0];
+        std::uint8_t *mid = &rows[stride];
+        std::uint8_t *down = &rows[2 * stride];
+        grayRow(data, width, reflectIndex(begin - 1, height), up);
+        grayRow(data, width, begin, mid);
+
+        for (int y = begin; y < end; y++) {
+            grayRow(data, width, reflectIndex(y + 1, height), down);
+
+            // both gradients from the same three rows, |g| <= 4 * 255
+            for (int x = 0; x < width; x++) {
+                int l = x, c = x + 1, r = x + 2;
+                gx[x] = (up[r] - up[l]) + 2 * (mid[r] - mid[l]) + (down[r] - down[l]);
+                gy[x] = (up[l] + 2 * up[c] + up[r]) - (down[l] + 2 * down[c] + down[r]);
+            }
+
+            // magnitude into gx, one loop per mode so each stays a plain vector loop
+            switch (magnitude) {
+              case EDGE_MAGNITUDE_L1:
+                for (int x = 0; x < width; x++) {
+                    gx[x] = std::min(255, ((std::abs(gx[x]) + std::abs(gy[x])) * gain + 128) >> 8);
+                }
+                break;
+              case EDGE_MAGNITUDE_ALPHA_MAX_BETA_MIN:
+                for (int x = 0; x < width; x++) {
+                    int ax = std::abs(gx[x]);
+                    int ay = std::abs(gy[x]);
+                    int m = (30 * std::max(ax, ay) + 15 * std::min(ax, ay)) >> 5;
+                    gx[x] = std::min(255, (m * gain + 128) >> 8);
+                }
+                break;
+              default: {
+                int x = 0;
+#if defined(__SSE2__)
+                // std::sqrt is not vectorized (errno), so take 4 at a time here
+                __m128 s4 = _mm_set1_ps(sensitivity);
+                __m128 cap = _mm_set1_ps(255.f);
+                __m128 half = _mm_set1_ps(0.5f);
+                for (; x + 4 <= width; x += 4) {
+                    alignas(16) std::int32_t sq[4];
+                    for (int i = 0; i < 4; i++) {
+                        sq[i] = gx[x+i] * gx[x+i] + gy[x+i] * gy[x+i];
+                    }
+                    __m128 m = _mm_mul_ps(s4, _mm_sqrt_ps(_mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(sq)))));
+                    __m128i v = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(m, cap), half));
+                    alignas(16) std::int32_t out[4];
+                    _mm_store_si128(reinterpret_cast<__m128i*>(out), v);
+                    for (int i = 0; i < 4; i++) {
+                        gx[x+i] = std::min(255, out[i]);
+                    }
+                }
+#endif
+                for (; x < width; x++) {
+                    float m = sensitivity * std::sqrt(float(gx[x] * gx[x] + gy[x] * gy[x]));
+                    gx[x] = std::min(255.f, m + 0.5f);
+                }
+              }
+            }
+
+            RGBA *dst = &result[size_t(y) * width];
+            for (int x = 0; x < width; x++) {
+                std::uint8_t v = gx[x];
+                dst[x] = RGBA{v, v, v, 255};
+            }
+
+            // slide the window down one row
+            std::uint8_t *recycled = up;
+            up = mid;
+            mid = down;
+            down = recycled;
+        }
+    });
+}
@@ -0,0 +1,34 @@
+#ifndef EDGE_H
+#define EDGE_H
+
+#include <vector>
+#include "rgba.h"
+
+/**
+ * @file    edge.h
+ *
+ * Sobel edge detection used by FILTER_EDGE_DETECT, fused into one sweep:
+ * each band of rows keeps three rows of 8-bit luminance (computed on the
+ * fly, with reflected borders) and evaluates both 3x3 gradients from them
+ * in integer arithmetic. The only full-size allocation is the output.
+ */
+
+// how the gradient (gx, gy) is turned into a magnitude
+enum EdgeMagnitude {
+    EDGE_MAGNITUDE_EXACT,       // sqrt(gx^2 + gy^2)
+    EDGE_MAGNITUDE_L1,          // |gx| + |gy|, overestimates diagonals by up to 41%
+    EDGE_MAGNITUDE_ALPHA_MAX_BETA_MIN, // 15/16 max + 15/32 min, within about 6%
+    NUM_EDGE_MAGNITUDES
+};
+
+// 0.299 r + 0.587 g + 0.114 b in 16-bit fixed point, truncated like rgbaToGray was.
+// The weights add up to 65536, so the luminance of a gray pixel is its own value
+inline std::uint8_t luminance(const RGBA &p) {
+    return (19595 * p.r + 38470 * p.g + 7471 * p.b) >> 16;
+}
+
+// gray image (alpha 255) of sensitivity * |gradient|, clamped to 255, written
+// to `result` (resized to fit, must not be `data`)
+void sobelEdges(const std::vector<RGBA> &data, int width, int height, float sensitivity, int magnitude, std::vector<RGBA> &result);
+
+#endif // EDGE_H
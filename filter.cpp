@@ -0,0 +1,34 @@
+#include "filter.h"
+#include "filtergraph.h"
+#include <cmath>
+using namespace std;
+
+/**
+ * @brief Applies the filter selected in the settings to the given image
+ */
+bool applyFilter(std::vector<RGBA> &data, int &width, int &height, const Settings &settings) {
+    FilterGraph graph;
+    if (!graph.add(settings.filterType, settings)) {
+        return false;
+    }
+    graph.run(data, width, height);
+    return true;
+}
+
+std::vector<float> createBlurFilter(int radius) {
+    int size = radius*2 + 1;
+    std::vector<float> filter(size);
+    float sigma = radius / 3.0;
+    float sum = 0;
+    for(int i = 0; i < size; i++) {
+        float x = i - radius;
+        filter[i] = (1/(sqrt(2*M_PI*pow(sigma, 2)))) * (exp(-(pow(x,2) / (2 * pow(sigma, 2)))));
+        sum += filter[i];
+    }
+    // normalize once here instead of dividing by the weight sum per pixel
+    for(int i = 0; i < size; i++) {
+        filter[i] /= sum;
+    }
+
+    return filter;
+}
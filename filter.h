@@ -0,0 +1,26 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <vector>
+#include "rgba.h"
+#include "settings.h"
+
+/**
+ * @file    filter.h
+ *
+ * The filter kernels used by Canvas2D::filterImage. They only depend on the
+ * pixel buffer and the parameters they are given (never on the GUI), so the
+ * same code runs inside the canvas and in the headless batch tool.
+ */
+
+// apply the filter selected in `settings` to `data`, in place.
+// `width`/`height` are updated when the filter changes the image size.
+// Returns false if the selected filter is not implemented. Chains of filters
+// go through FilterGraph (filtergraph.h), which this runs with one stage.
+bool applyFilter(std::vector<RGBA> &data, int &width, int &height, const Settings &settings);
+
+// helper function - Filter
+// normalized 1D Gaussian with 2*radius+1 taps
+std::vector<float> createBlurFilter(int radius);
+
+#endif // FILTER_H
@@ -0,0 +1,428 @@
+#include "filtergraph.h"
+#include "bilateral.h"
+#include "blur.h"
+#include "chromatic.h"
+#include "edge.h"
+#include "median.h"
+#include "parallel.h"
+#include "rotate.h"
+#include "scale.h"
+#include "tiledimage.h"
+#include "tonemap.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+// FILTER_BILATERAL parameters
+static constexpr double BILATERAL_SIGMA_S = 3.0;
+static constexpr double BILATERAL_SIGMA_R = 0.1;
+// the bilateral grid has one cell per sigma_s pixels; tiles start on a cell
+// boundary so their grids line up with the one of the whole image
+static constexpr int BILATERAL_CELL = 3;
+
+FilterGraph &FilterGraph::gray() {
+    m_stages.push_back(Stage{STAGE_GRAY});
+    return *this;
+}
+
+FilterGraph &FilterGraph::invert() {
+    Curves inverted;
+    for (auto &lut : inverted) {
+        for (int v = 0; v < 256; v++) {
+            lut[v] = 255 - v;
+        }
+    }
+    return curves(inverted);
+}
+
+FilterGraph &FilterGraph::curves(const Curves &curves) {
+    Stage stage{STAGE_CURVES};
+    stage.curves = curves;
+    m_stages.push_back(stage);
+    return *this;
+}
+
+FilterGraph &FilterGraph::toneMap(bool nonLinear, float gamma, float clip) {
+    Stage stage{STAGE_TONEMAP};
+    stage.mode = nonLinear;
+    stage.x = gamma;
+    stage.y = clip;
+    m_stages.push_back(stage);
+    return *this;
+}
+
+FilterGraph &FilterGraph::blur(int radius) {
+    Stage stage{STAGE_BLUR};
+    stage.radius = radius;
+    m_stages.push_back(stage);
+    return *this;
+}
+
+FilterGraph &FilterGraph::edges(float sensitivity, int magnitude) {
+    Stage stage{STAGE_EDGES};
+    stage.x = sensitivity;
+    stage.mode = magnitude;
+    m_stages.push_back(stage);
+    return *this;
+}
+
+FilterGraph &FilterGraph::median(int radius) {
+    Stage stage{STAGE_MEDIAN};
+    stage.radius = std::min(radius, MAX_MEDIAN_RADIUS);
+    m_stages.push_back(stage);
+    return *this;
+}
+
+FilterGraph &FilterGraph::bilateral(int radius, bool grid) {
+    Stage stage{grid ? STAGE_BILATERAL_GRID : STAGE_BILATERAL};
+    stage.radius = radius;
+    m_stages.push_back(stage);
+    return *this;
+}
+
+FilterGraph &FilterGraph::scale(float scaleX, float scaleY) {
+    Stage stage{STAGE_SCALE};
+    stage.x = scaleX;
+    stage.y = scaleY;
+    m_stages.push_back(stage);
+    return *this;
+}
+
+FilterGraph &FilterGraph::rotate(float degrees) {
+    Stage stage{STAGE_ROTATE};
+    stage.x = degrees;
+    m_stages.push_back(stage);
+    return *this;
+}
+
+FilterGraph &FilterGraph::chromatic(float lambda_r, float lambda_g, float lambda_b) {
+    Stage stage{STAGE_CHROMATIC};
+    stage.x = lambda_r;
+    stage.y = lambda_g;
+    stage.z = lambda_b;
+    m_stages.push_back(stage);
+    return *this;
+}
+
+/**
+ * @brief Appends the stage the given filter runs with these settings
+ */
+bool FilterGraph::add(int filterType, const Settings &settings) {
+    switch (filterType) {
+      case FILTER_BLUR:
+        blur(settings.blurRadius);
+        return true;
+      case FILTER_EDGE_DETECT:
+        edges(settings.edgeDetectSensitivity, settings.edgeMagnitude);
+        return true;
+      case FILTER_SCALE:
+        scale(settings.scaleX, settings.scaleY);
+        return true;
+      case FILTER_MEDIAN:
+        median(settings.medianRadius);
+        return true;
+      case FILTER_BILATERAL:
+        bilateral(settings.bilateralRadius, settings.bilateralGrid);
+        return true;
+      case FILTER_ROTATION:
+        rotate(settings.rotationAngle);
+        return true;
+      case FILTER_CHROMATIC:
+        chromatic(settings.lambda_1, settings.lambda_2, settings.lambda_3);
+        return true;
+      case FILTER_MAPPING:
+        toneMap(settings.nonLinearMap, settings.gamma, settings.toneClip / 100);
+        return true;
+      default:
+        return false;
+    }
+}
+
+void FilterGraph::run(std::vector<RGBA> &data, int &width, int &height) {
+    runRange(data, width, height, m_stages.cbegin(), m_stages.cend());
+}
+
+/**
+ * @brief Runs stages [begin, end); per-pixel runs are fused, the rest ping-pong between data and m_scratch
+ */
+void FilterGraph::runRange(std::vector<RGBA> &data, int &width, int &height, StageIterator begin, StageIterator end) {
+    auto stage = begin;
+    while (stage != end) {
+        if (stage->type == STAGE_TONEMAP) {
+            runToneMap(*stage, data.data(), data.size());
+            ++stage;
+        } else if (perPixel(stage->type)) {
+            auto last = std::find_if_not(stage, end, [](const Stage &s) { return perPixel(s.type); });
+            runPerPixel(data, stage, last);
+            stage = last;
+        } else {
+            runStage(*stage, data, width, height, m_scratch);
+            // O(1): the buffers trade places, the old input becomes scratch
+            std::swap(data, m_scratch);
+            ++stage;
+        }
+    }
+}
+
+/**
+ * @brief Applies the per-pixel stages [begin, end) to data in a single pass
+ */
+void FilterGraph::runPerPixel(std::vector<RGBA> &data, StageIterator begin, StageIterator end) {
+    // fuse: curves after curves become one table, gray after gray is a no-op
+    std::vector<Stage> ops;
+    for (auto stage = begin; stage != end; ++stage) {
+        if (!ops.empty() && ops.back().type == stage->type) {
+            if (stage->type == STAGE_CURVES) {
+                for (int c = 0; c < 3; c++) {
+                    for (auto &v : ops.back().curves[c]) {
+                        v = stage->curves[c][v];
+                    }
+                }
+            }
+            continue;
+        }
+        ops.push_back(*stage);
+    }
+    // the edge detector reads luminance, and the luminance of a gray pixel is itself
+    if (end != m_stages.cend() && end->type == STAGE_EDGES && ops.back().type == STAGE_GRAY) {
+        ops.pop_back();
+    }
+    applyPerPixel(data.data(), data.size(), ops);
+}
+
+/**
+ * @brief Applies gray and curves stages to `count` pixels in one pass
+ */
+void FilterGraph::applyPerPixel(RGBA *pixels, std::size_t count, const std::vector<Stage> &ops) {
+    if (ops.empty()) {
+        return;
+    }
+
+    parallelFor(0, int(count / 4096) + 1, 16, [&](int begin, int end) {
+        size_t first = size_t(begin) * 4096;
+        size_t last = std::min(count, size_t(end) * 4096);
+        for (const Stage &op : ops) {
+            if (op.type == STAGE_GRAY) {
+                for (size_t i = first; i < last; i++) {
+                    std::uint8_t v = luminance(pixels[i]);
+                    pixels[i] = RGBA{v, v, v, pixels[i].a};
+                }
+            } else {
+                const auto &[r, g, b] = op.curves;
+                for (size_t i = first; i < last; i++) {
+                    pixels[i] = RGBA{r[pixels[i].r], g[pixels[i].g], b[pixels[i].b], pixels[i].a};
+                }
+            }
+        }
+    });
+}
+
+/**
+ * @brief Tone maps `count` pixels: a histogram pass, then the curves it gives
+ */
+void FilterGraph::runToneMap(const Stage &stage, RGBA *pixels, std::size_t count) {
+    ToneHistogram histogram;
+    channelHistogram(pixels, count, histogram);
+    Stage curves{STAGE_CURVES};
+    toneCurves(histogram, stage.y, stage.mode, stage.x, curves.curves);
+    applyPerPixel(pixels, count, {curves});
+}
+
+/**
+ * @brief Runs one neighbourhood stage from src into dst
+ */
+void FilterGraph::runStage(const Stage &stage, const std::vector<RGBA> &src, int &width, int &height,
+                           std::vector<RGBA> &dst) {
+    double sigma_s = BILATERAL_SIGMA_S;
+    double sigma_r = BILATERAL_SIGMA_R;
+    switch (stage.type) {
+      case STAGE_BLUR:
+        gaussianBlur(src, width, height, stage.radius, dst);
+        break;
+      case STAGE_EDGES:
+        sobelEdges(src, width, height, stage.x, stage.mode, dst);
+        break;
+      case STAGE_MEDIAN:
+        medianFilter(src, width, height, stage.radius, dst);
+        break;
+      case STAGE_BILATERAL:
+        bilateralFilter(src, width, height, stage.radius, sigma_s, sigma_r, dst);
+        break;
+      case STAGE_BILATERAL_GRID:
+        bilateralGrid(src, width, height, sigma_s, sigma_r, dst);
+        break;
+      case STAGE_SCALE: {
+        int output_width = std::max(1, int(std::round(width * stage.x)));
+        int output_height = std::max(1, int(std::round(height * stage.y)));
+        scaleImage(src, width, height, stage.x, stage.y, output_width, output_height, dst);
+        width = output_width;
+        height = output_height;
+        break;
+      }
+      case STAGE_ROTATE:
+        rotateImage(src, width, height, stage.x, dst);
+        rotatedSize(width, height, stage.x, width, height);
+        break;
+      case STAGE_CHROMATIC:
+        chromaticAberration(src, width, height, {stage.x, stage.y, stage.z}, dst);
+        break;
+      default:
+        break;
+    }
+}
+
+int FilterGraph::halo(const Stage &stage) {
+    switch (stage.type) {
+      case STAGE_BLUR:
+      case STAGE_MEDIAN:
+      case STAGE_BILATERAL:
+        return std::max(0, stage.radius);
+      case STAGE_EDGES:
+        return 1;
+      case STAGE_BILATERAL_GRID:
+        // splat to the nearest cell, [1 4 6 4 1] blur, trilinear slice:
+        // about 3.5 cells, rounded up
+        return 5 * BILATERAL_CELL;
+      default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Runs the stages of the chain on an out-of-core image, in place
+ */
+bool FilterGraph::runTiled(TiledImage &image) {
+    auto stage = m_stages.cbegin();
+    while (stage != m_stages.cend()) {
+        if (stage->type == STAGE_TONEMAP) {
+            // pixels are row-major in one mapping; the kernel pages them through
+            runToneMap(*stage, image.row(0), size_t(image.width()) * image.height());
+            ++stage;
+        } else if (global(stage->type)) {
+            bool ok = stage->type == STAGE_SCALE ? runScaleBands(image, *stage) : runWarpTiles(image, *stage);
+            if (!ok) {
+                return false;
+            }
+            ++stage;
+        } else {
+            auto end = std::find_if(stage, m_stages.cend(), [](const Stage &s) { return global(s.type); });
+            if (!runTiles(image, stage, end)) {
+                return false;
+            }
+            stage = end;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Runs stages [begin, end) (no global stage among them) tile by tile into a new image
+ */
+bool FilterGraph::runTiles(TiledImage &image, StageIterator begin, StageIterator end) {
+    // errors near a tile's border spread inwards by each stage's radius in
+    // turn, so the halo is their sum
+    int border = 0;
+    int align = 1;
+    for (auto stage = begin; stage != end; ++stage) {
+        border += halo(*stage);
+        if (stage->type == STAGE_BILATERAL_GRID) {
+            align = BILATERAL_CELL;
+        }
+    }
+
+    TiledImage result(image.scratchDir());
+    if (!result.allocate(image.width(), image.height())) {
+        return false;
+    }
+    std::vector<RGBA> tile;
+    for (int y = 0; y < image.height(); y += TiledImage::TILE) {
+        for (int x = 0; x < image.width(); x += TiledImage::TILE) {
+            int w = std::min(TiledImage::TILE, image.width() - x);
+            int h = std::min(TiledImage::TILE, image.height() - y);
+            // the halo is clipped at the image border, where the filters
+            // reflect (or clip) exactly as they do on the whole image
+            int x0 = std::max(0, x - border);
+            int y0 = std::max(0, y - border);
+            x0 -= x0 % align;
+            y0 -= y0 % align;
+            int tile_width = std::min(image.width(), x + w + border) - x0;
+            int tile_height = std::min(image.height(), y + h + border) - y0;
+
+            image.read(x0, y0, tile_width, tile_height, tile);
+            runRange(tile, tile_width, tile_height, begin, end);
+            result.write(x, y, w, h, &tile[size_t(y - y0) * tile_width + (x - x0)], tile_width);
+        }
+    }
+    image.swap(result);
+    return true;
+}
+
+/**
+ * @brief Scales an out-of-core image into a new one, a band of output rows at a time
+ */
+bool FilterGraph::runScaleBands(TiledImage &image, const Stage &stage) {
+    int width = image.width();
+    int height = image.height();
+    int output_width = std::max(1, int(std::round(width * stage.x)));
+    int output_height = std::max(1, int(std::round(height * stage.y)));
+    TiledImage result(image.scratchDir());
+    if (!result.allocate(output_width, output_height)) {
+        return false;
+    }
+
+    // output rows per band: about four tiles' worth of source pixels
+    double source_rows = 4.0 * TiledImage::TILE * TiledImage::TILE / width;
+    int band = std::max(1, int(source_rows * stage.y));
+    std::vector<RGBA> rows;
+    for (int o = 0; o < output_height; o += band) {
+        int o_end = std::min(output_height, o + band);
+        int src_begin, src_end;
+        scaleSourceRows(height, stage.y, output_height, o, o_end, src_begin, src_end);
+        image.read(0, src_begin, width, src_end - src_begin, rows);
+        scaleImageRows(rows, width, height, src_begin, stage.x, stage.y, output_width, output_height, o, o_end, m_scratch);
+        result.write(0, o, output_width, o_end - o, m_scratch.data(), output_width);
+    }
+    image.swap(result);
+    return true;
+}
+
+/**
+ * @brief Rotates or warps an out-of-core image into a new one, an output tile at a time
+ */
+bool FilterGraph::runWarpTiles(TiledImage &image, const Stage &stage) {
+    int width = image.width();
+    int height = image.height();
+    int output_width = width;
+    int output_height = height;
+    if (stage.type == STAGE_ROTATE) {
+        rotatedSize(width, height, stage.x, output_width, output_height);
+    }
+    std::array<float, 3> lambda = {stage.x, stage.y, stage.z};
+    TiledImage result(image.scratchDir());
+    if (!result.allocate(output_width, output_height)) {
+        return false;
+    }
+
+    // a tile reads a rotated square of the source, at most about 1.4 tiles
+    // wide, or a slightly magnified one for chromatic aberration
+    std::vector<RGBA> rect;
+    for (int y = 0; y < output_height; y += TiledImage::TILE) {
+        for (int x = 0; x < output_width; x += TiledImage::TILE) {
+            int w = std::min(TiledImage::TILE, output_width - x);
+            int h = std::min(TiledImage::TILE, output_height - y);
+            int src_x, src_y, src_w, src_h;
+            if (stage.type == STAGE_ROTATE) {
+                rotateSourceRect(width, height, stage.x, x, y, w, h, src_x, src_y, src_w, src_h);
+                image.read(src_x, src_y, src_w, src_h, rect);
+                rotateImageRect(rect, src_x, src_y, src_w, src_h, width, height, stage.x, x, y, w, h, m_scratch);
+            } else {
+                chromaticSourceRect(width, height, lambda, x, y, w, h, src_x, src_y, src_w, src_h);
+                image.read(src_x, src_y, src_w, src_h, rect);
+                chromaticImageRect(rect, src_x, src_y, src_w, src_h, width, height, lambda, x, y, w, h, m_scratch);
+            }
+            result.write(x, y, w, h, m_scratch.data(), w);
+        }
+    }
+    image.swap(result);
+    return true;
+}
@@ -0,0 +1,125 @@
+#ifndef FILTERGRAPH_H
+#define FILTERGRAPH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "rgba.h"
+#include "settings.h"
+
+class TiledImage;
+
+/**
+ * @file    filtergraph.h
+ *
+ * A chain of filter stages run as one edit, e.g. gray -> blur -> edges or
+ * scale -> blur. The chain is described once and then run on any image:
+ *
+ * - per-pixel stages (gray, curves, invert) next to each other are fused
+ *   into a single pass over the image; consecutive curves are composed
+ *   into one table, and a gray stage right before edges is dropped since
+ *   the edge detector takes the luminance anyway.
+ * - tone mapping measures the image as it is at that point of the chain
+ *   (a histogram) and then runs as a curves pass.
+ * - neighbourhood stages (blur, edges, median, bilateral, scale, rotate,
+ *   chromatic) write into a second buffer and the two buffers swap roles
+ *   after every stage, so a chain of any length needs one extra image,
+ *   allocated once and kept between runs. The result is swapped back into
+ *   the caller's vector without copying.
+ *
+ * runTiled does the same for images kept out of core in a TiledImage: the
+ * stages between two scale, rotate, chromatic or tone mapping stages run
+ * one tile at a time on the tile plus a halo as wide as the sum of their
+ * radii, which gives the same pixels as running them on the whole image.
+ * Scale stages run in bands of output rows, rotate and chromatic stages one
+ * output tile at a time from the source rectangle it reads, and tone
+ * mapping over the whole mapped image.
+ */
+
+class FilterGraph
+{
+public:
+    // one lookup table per channel: r, g, b
+    using Curves = std::array<std::array<std::uint8_t, 256>, 3>;
+
+    // per-pixel stages
+    FilterGraph &gray();
+    FilterGraph &invert();
+    FilterGraph &curves(const Curves &curves);
+    FilterGraph &toneMap(bool nonLinear, float gamma, float clip = 0);
+
+    // neighbourhood stages, with the same parameters as the FILTER_* kernels
+    FilterGraph &blur(int radius);
+    FilterGraph &edges(float sensitivity, int magnitude);
+    FilterGraph &median(int radius);
+    FilterGraph &bilateral(int radius, bool grid);
+    FilterGraph &scale(float scaleX, float scaleY);
+    FilterGraph &rotate(float degrees);
+    FilterGraph &chromatic(float lambda_r, float lambda_g, float lambda_b);
+
+    // appends the stage FILTER_<filterType> runs with these settings.
+    // Returns false if that filter is not implemented
+    bool add(int filterType, const Settings &settings);
+
+    bool empty() const { return m_stages.empty(); }
+    void clear() { m_stages.clear(); }
+
+    // runs every stage on `data`, in place; `width`/`height` follow scale stages
+    void run(std::vector<RGBA> &data, int &width, int &height);
+    // runs every stage on `image`, in place, keeping only a tile (or a band)
+    // and its halo in memory. False if a scratch image cannot be allocated
+    bool runTiled(TiledImage &image);
+
+private:
+    enum StageType {
+        STAGE_GRAY,
+        STAGE_CURVES,
+        STAGE_BLUR,
+        STAGE_EDGES,
+        STAGE_MEDIAN,
+        STAGE_BILATERAL,
+        STAGE_BILATERAL_GRID,
+        STAGE_SCALE,
+        STAGE_ROTATE,
+        STAGE_CHROMATIC,
+        STAGE_TONEMAP
+    };
+
+    struct Stage {
+        StageType type;
+        int radius = 0;
+        int mode = 0;
+        float x = 0;
+        float y = 0;
+        float z = 0;
+        Curves curves = {};
+    };
+
+    using StageIterator = std::vector<Stage>::const_iterator;
+
+    static bool perPixel(StageType type) { return type == STAGE_GRAY || type == STAGE_CURVES; }
+    // stages that need the whole image rather than a tile and its halo;
+    // runTiled runs them on their own
+    static bool global(StageType type) {
+        return type == STAGE_SCALE || type == STAGE_ROTATE
+            || type == STAGE_CHROMATIC || type == STAGE_TONEMAP;
+    }
+    // pixels around an output pixel a stage reads
+    static int halo(const Stage &stage);
+
+    void runRange(std::vector<RGBA> &data, int &width, int &height, StageIterator begin, StageIterator end);
+    bool runTiles(TiledImage &image, StageIterator begin, StageIterator end);
+    bool runScaleBands(TiledImage &image, const Stage &stage);
+    bool runWarpTiles(TiledImage &image, const Stage &stage);
+    void runPerPixel(std::vector<RGBA> &data, StageIterator begin, StageIterator end);
+    static void applyPerPixel(RGBA *pixels, std::size_t count, const std::vector<Stage> &ops);
+    static void runToneMap(const Stage &stage, RGBA *pixels, std::size_t count);
+    void runStage(const Stage &stage, const std::vector<RGBA> &src, int &width, int &height,
+                  std::vector<RGBA> &dst);
+
+    std::vector<Stage> m_stages;
+    std::vector<RGBA> m_scratch; // the second buffer of the ping-pong pair
+};
+
+#endif // FILTERGRAPH_H
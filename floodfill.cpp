@@ -0,0 +1,189 @@
+#include "floodfill.h"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// the common tolerance 0 case compares whole pixels as one 32-bit word
+inline std::uint32_t packed(const RGBA &p) {
+    std::uint32_t v;
+    std::memcpy(&v, &p, sizeof(v));
+    return v;
+}
+
+struct ColorMatch {
+    RGBA reference;
+    std::uint32_t reference_packed;
+    int tolerance;
+    bool invert;
+
+    bool operator()(const RGBA &p) const {
+        if (tolerance == 0) {
+            return (packed(p) == reference_packed) != invert;
+        }
+        int diff = std::max({std::abs(p.r - reference.r), std::abs(p.g - reference.g),
+                             std::abs(p.b - reference.b), std::abs(p.a - reference.a)});
+        return (diff <= tolerance) != invert;
+    }
+};
+
+// end of the run of matching pixels starting at x (exclusive)
+inline int matchRight(const ColorMatch &inside, const RGBA *row, int x, int width) {
+    if (inside.tolerance == 0 && !inside.invert) {
+        while (x < width && packed(row[x]) == inside.reference_packed) {
+            x++;
+        }
+        return x;
+    }
+    while (x < width && inside(row[x])) {
+        x++;
+    }
+    return x;
+}
+
+// start of the run of matching pixels ending just before x
+inline int matchLeft(const ColorMatch &inside, const RGBA *row, int x) {
+    while (x > 0 && inside(row[x - 1])) {
+        x--;
+    }
+    return x;
+}
+
+// bits [lo, hi) of a 64-bit word
+inline std::uint64_t bitRange(int lo, int hi) {
+    std::uint64_t upper = hi == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << hi) - 1;
+    return upper & ~((std::uint64_t(1) << lo) - 1);
+}
+
+} // namespace
+
+int FloodFill::firstSet(int y, int x0, int x1) const {
+    // first selected pixel in [x0, x1), or x1
+    std::size_t begin = std::size_t(y) * m_width + x0;
+    std::size_t end = std::size_t(y) * m_width + x1;
+    while (begin < end) {
+        std::uint64_t word = m_mask[begin >> 6] >> (begin & 63);
+        if (word) {
+            return int(std::min(begin + std::countr_zero(word), end) - std::size_t(y) * m_width);
+        }
+        begin = (begin | 63) + 1;
+    }
+    return x1;
+}
+
+int FloodFill::firstClear(int y, int x) const {
+    // one past the last selected pixel left of x, or 0
+    std::size_t row = std::size_t(y) * m_width;
+    std::size_t i = row + x;
+    while (i > row) {
+        std::size_t last = i - 1;
+        std::uint64_t word = m_mask[last >> 6] << (63 - (last & 63));
+        if (word) {
+            std::size_t hit = last - std::countl_zero(word);
+            return int(std::max(hit + 1, row) - row);
+        }
+        i = last & ~std::size_t(63);
+    }
+    return 0;
+}
+
+void FloodFill::mark(int y, int x0, int x1) {
+    std::size_t begin = std::size_t(y) * m_width + x0;
+    std::size_t end = std::size_t(y) * m_width + x1;
+    while (begin < end) {
+        std::size_t word = begin >> 6;
+        int lo = int(begin & 63);
+        int hi = int(std::min<std::size_t>(64, lo + (end - begin)));
+        m_mask[word] |= bitRange(lo, hi);
+        begin += hi - lo;
+    }
+    m_region.x0 = std::min(m_region.x0, x0);
+    m_region.x1 = std::max(m_region.x1, x1);
+    m_region.y0 = std::min(m_region.y0, y);
+    m_region.y1 = std::max(m_region.y1, y + 1);
+    m_region.pixels += x1 - x0;
+}
+
+FillRegion FloodFill::select(const std::vector<RGBA> &data, int width, int height, int x, int y,
+                             RGBA reference, int tolerance, bool invert, bool eight_connected) {
+    m_width = width;
+    m_height = height;
+    // assign() keeps the capacity, so repeated fills on one canvas do not allocate
+    m_mask.assign((std::size_t(width) * height + 63) / 64, 0);
+    m_region = FillRegion{width, height, 0, 0, 0};
+    m_stack.clear();
+
+    ColorMatch inside{reference, packed(reference), tolerance, invert};
+    auto open = [&](const RGBA *row, int px, int py) {
+        return !selected(px, py) && inside(row[px]);
+    };
+    // marks the widest open span through (px, py) and queues it for its neighbors
+    auto grow = [&](const RGBA *row, int px, int py) {
+        // match colors first, then cut the run at the nearest selected pixel
+        int left = std::max(matchLeft(inside, row, px), firstClear(py, px));
+        int right = std::min(matchRight(inside, row, px + 1, width), firstSet(py, px + 1, width));
+        mark(py, left, right);
+        m_stack.push_back({py, left, right});
+        return right;
+    };
+
+    if (x >= 0 && x < width && y >= 0 && y < height) {
+        const RGBA *row = &data[std::size_t(y) * width];
+        if (inside(row[x])) {
+            grow(row, x, y);
+        }
+    }
+    while (!m_stack.empty()) {
+        Span span = m_stack.back();
+        m_stack.pop_back();
+
+        // every open run touching the span on the rows above and below becomes a span itself
+        int scan0 = eight_connected ? std::max(0, span.x0 - 1) : span.x0;
+        int scan1 = eight_connected ? std::min(width, span.x1 + 1) : span.x1;
+        for (int ny : {span.y - 1, span.y + 1}) {
+            if (ny < 0 || ny >= height) {
+                continue;
+            }
+            const RGBA *row = &data[std::size_t(ny) * width];
+            std::size_t base = std::size_t(ny) * width;
+            int nx = scan0;
+            while (nx < scan1) {
+                std::size_t i = base + nx;
+                // skip whole words of already selected pixels (usually the row we came from)
+                if ((i & 63) == 0 && m_mask[i >> 6] == ~std::uint64_t(0)) {
+                    nx += 64;
+                } else if (open(row, nx, ny)) {
+                    nx = grow(row, nx, ny);
+                } else {
+                    nx++;
+                }
+            }
+        }
+    }
+
+    if (m_region.pixels == 0) {
+        m_region = FillRegion{};
+    }
+    return m_region;
+}
+
+void FloodFill::paint(std::vector<RGBA> &data, RGBA color) const {
+    for (int y = m_region.y0; y < m_region.y1; y++) {
+        std::size_t i = std::size_t(y) * m_width + m_region.x0;
+        std::size_t end = std::size_t(y) * m_width + m_region.x1;
+        while (i < end) {
+            std::uint64_t word = m_mask[i >> 6];
+            if ((i & 63) == 0 && end - i >= 64 && word == ~std::uint64_t(0)) {
+                std::fill_n(data.begin() + i, 64, color);
+                i += 64;
+                continue;
+            }
+            if ((word >> (i & 63)) & 1) {
+                data[i] = color;
+            }
+            i++;
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef FLOODFILL_H
+#define FLOODFILL_H
+
+#include <cstdint>
+#include <vector>
+#include "rgba.h"
+
+// bounding box [x0, x1) x [y0, y1) of a selected region
+struct FillRegion {
+    int x0 = 0;
+    int y0 = 0;
+    int x1 = 0;
+    int y1 = 0;
+    long long pixels = 0;
+};
+
+/**
+ * @brief Scanline flood fill shared by the fill bucket and the connected
+ * eraser.
+ *
+ * `select` finds the region connected to a seed pixel one horizontal span at
+ * a time (each pixel is color-tested about once) and records it in a bit-packed mask (1 bit per pixel) that is
+ * reused between calls, so a fill allocates nothing once the mask has grown
+ * to the canvas size. The image is not touched while selecting; callers can
+ * then `paint` the region or only query the mask.
+ */
+class FloodFill {
+public:
+    // Selects the pixels connected to (x, y) that are within `tolerance`
+    // (max difference over r, g, b, a) of `reference`, or, with `invert`,
+    // the ones that are not. `eight_connected` also joins diagonal pixels.
+    FillRegion select(const std::vector<RGBA> &data, int width, int height, int x, int y,
+                      RGBA reference, int tolerance, bool invert, bool eight_connected);
+
+    bool selected(int x, int y) const {
+        std::size_t i = std::size_t(y) * m_width + x;
+        return (m_mask[i >> 6] >> (i & 63)) & 1;
+    }
+
+    // sets every selected pixel of `data` to `color`
+    void paint(std::vector<RGBA> &data, RGBA color) const;
+
+    const FillRegion &region() const { return m_region; }
+    const std::vector<std::uint64_t> &mask() const { return m_mask; }
+
+private:
+    // a selected run [x0, x1) on row y whose neighbors are not scanned yet
+    struct Span {
+        int y;
+        int x0;
+        int x1;
+    };
+
+    void mark(int y, int x0, int x1);
+    int firstSet(int y, int x0, int x1) const;
+    int firstClear(int y, int x) const;
+
+    int m_width = 0;
+    int m_height = 0;
+    FillRegion m_region;
+    std::vector<std::uint64_t> m_mask;
+    std::vector<Span> m_stack;
+};
+
+#endif // FLOODFILL_H
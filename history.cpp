@@ -0,0 +1,203 @@
+#include "history.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// steps closer than this to the current one stay uncompressed, so a few
+// quick undos don't have to inflate anything
+constexpr int UNCOMPRESSED_STEPS = 2;
+}
+
+History::History(std::size_t budget_bytes) : m_budget(budget_bytes) {}
+
+void History::setBudget(std::size_t bytes) {
+    m_budget = bytes;
+    enforceBudget();
+}
+
+void History::setCompression(bool enabled) {
+    if (enabled == m_compression) {
+        return;
+    }
+    m_compression = enabled;
+    if (enabled) {
+        for (int i = 0; i <= m_current - UNCOMPRESSED_STEPS; i++) {
+            compressStep(i);
+        }
+    }
+}
+
+void History::reset(const std::vector<RGBA> &data, int width, int height) {
+    m_steps.clear();
+    m_current = -1;
+    markAllDirty();
+    commit(data, width, height);
+}
+
+void History::markDirty(int x0, int y0, int x1, int y1) {
+    if (m_current < 0) {
+        return;
+    }
+    const Step &step = m_steps[m_current];
+    int nx = tilesX(step.width);
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, step.width);
+    y1 = std::min(y1, step.height);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    for (int ty = y0 / TILE; ty <= (y1 - 1) / TILE; ty++) {
+        for (int tx = x0 / TILE; tx <= (x1 - 1) / TILE; tx++) {
+            m_dirty[ty * nx + tx] = true;
+        }
+    }
+}
+
+void History::markAllDirty() {
+    std::fill(m_dirty.begin(), m_dirty.end(), true);
+}
+
+std::shared_ptr<History::Tile> History::copyTile(const std::vector<RGBA> &data, int width, int height, int tx, int ty) {
+    int x0 = tx * TILE, y0 = ty * TILE;
+    int w = std::min(TILE, width - x0), h = std::min(TILE, height - y0);
+    auto tile = std::make_shared<Tile>(&m_usage);
+    tile->pixels.resize(w * h);
+    for (int row = 0; row < h; row++) {
+        std::memcpy(&tile->pixels[row * w], &data[size_t(y0 + row) * width + x0], w * sizeof(RGBA));
+    }
+    m_usage += tile->bytes();
+    return tile;
+}
+
+void History::restoreTile(const Tile &tile, std::vector<RGBA> &data, int width, int height, int tx, int ty) const {
+    int x0 = tx * TILE, y0 = ty * TILE;
+    int w = std::min(TILE, width - x0), h = std::min(TILE, height - y0);
+    const RGBA *src = tile.pixels.data();
+    QByteArray inflated;
+    if (tile.pixels.empty()) {
+        inflated = qUncompress(tile.compressed);
+        src = reinterpret_cast<const RGBA*>(inflated.constData());
+    }
+    for (int row = 0; row < h; row++) {
+        std::memcpy(&data[size_t(y0 + row) * width + x0], &src[row * w], w * sizeof(RGBA));
+    }
+}
+
+bool History::commit(const std::vector<RGBA> &data, int width, int height) {
+    bool resized = m_current < 0 || m_steps[m_current].width != width || m_steps[m_current].height != height;
+    if (!resized && std::find(m_dirty.begin(), m_dirty.end(), true) == m_dirty.end()) {
+        return false;
+    }
+
+    // a new step discards everything that could have been redone
+    m_steps.resize(m_current + 1);
+
+    Step step;
+    step.width = width;
+    step.height = height;
+    int nx = tilesX(width), ny = tilesY(height);
+    step.tiles.resize(nx * ny);
+    for (int ty = 0; ty < ny; ty++) {
+        for (int tx = 0; tx < nx; tx++) {
+            int i = ty * nx + tx;
+            step.tiles[i] = resized || m_dirty[i] ? copyTile(data, width, height, tx, ty)
+                                                  : m_steps[m_current].tiles[i];
+        }
+    }
+    m_steps.push_back(std::move(step));
+    m_current++;
+    m_dirty.assign(nx * ny, false);
+
+    if (m_compression) {
+        compressStep(m_current - UNCOMPRESSED_STEPS);
+    }
+    enforceBudget();
+    return true;
+}
+
+void History::compressStep(int index) {
+    if (index < 0) {
+        return;
+    }
+    const Step &current = m_steps[m_current];
+    Step &step = m_steps[index];
+    bool same_size = step.width == current.width && step.height == current.height;
+    for (size_t i = 0; i < step.tiles.size(); i++) {
+        Tile &tile = *step.tiles[i];
+        // tiles still shown on the canvas are left alone
+        if (tile.pixels.empty() || (same_size && step.tiles[i] == current.tiles[i])) {
+            continue;
+        }
+        m_usage -= tile.bytes();
+        tile.compressed = qCompress(reinterpret_cast<const uchar*>(tile.pixels.data()),
+                                    tile.pixels.size() * sizeof(RGBA), 1);
+        std::vector<RGBA>().swap(tile.pixels);
+        m_usage += tile.bytes();
+    }
+}
+
+void History::enforceBudget() {
+    // the current step is always kept, whatever the budget
+    while (m_usage > m_budget && m_current > 0) {
+        m_steps.erase(m_steps.begin());
+        m_current--;
+    }
+    while (m_usage > m_budget && int(m_steps.size()) > m_current + 1) {
+        m_steps.pop_back();
+    }
+}
+
+void History::restore(const Step &from, const Step &to, std::vector<RGBA> &data, int &width, int &height) {
+    bool resized = from.width != to.width || from.height != to.height;
+    if (resized) {
+        width = to.width;
+        height = to.height;
+        data.resize(size_t(width) * height);
+    }
+    int nx = tilesX(width), ny = tilesY(height);
+    for (int ty = 0; ty < ny; ty++) {
+        for (int tx = 0; tx < nx; tx++) {
+            int i = ty * nx + tx;
+            // uncommitted edits (dirty tiles) are thrown away as well
+            if (resized || m_dirty[i] || from.tiles[i] != to.tiles[i]) {
+                restoreTile(*to.tiles[i], data, width, height, tx, ty);
+            }
+        }
+    }
+    m_dirty.assign(nx * ny, false);
+}
+
+bool History::canUndo() const {
+    return m_current > 0;
+}
+
+bool History::canRedo() const {
+    return m_current + 1 < int(m_steps.size());
+}
+
+bool History::undo(std::vector<RGBA> &data, int &width, int &height) {
+    if (!canUndo()) {
+        return false;
+    }
+    restore(m_steps[m_current], m_steps[m_current - 1], data, width, height);
+    m_current--;
+    return true;
+}
+
+bool History::redo(std::vector<RGBA> &data, int &width, int &height) {
+    if (!canRedo()) {
+        return false;
+    }
+    restore(m_steps[m_current], m_steps[m_current + 1], data, width, height);
+    m_current++;
+    return true;
+}
+
+int History::steps() const {
+    return m_steps.size();
+}
+
+std::size_t History::memoryUsage() const {
+    return m_usage;
+}
@@ -0,0 +1,94 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <QByteArray>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "rgba.h"
+
+/**
+ * @brief Undo/redo history for the canvas, stored as copy-on-write tiles.
+ *
+ * The image is cut into TILE x TILE tiles. Every step is a list of shared
+ * tile pointers; a new step copies only the tiles that were marked dirty
+ * since the last commit and shares every other tile with the step before.
+ * A brush stroke therefore costs the tiles it touched, not the whole image.
+ *
+ * Old steps are dropped once the tiles they hold exceed the memory budget,
+ * and can optionally be compressed (qCompress) once they are a few steps
+ * behind the current one.
+ */
+class History {
+public:
+    static constexpr int TILE = 64;
+
+    explicit History(std::size_t budget_bytes = 256u << 20);
+
+    // tiles point back at m_usage, so a History stays where it was made
+    History(const History &) = delete;
+    History &operator=(const History &) = delete;
+    History(History &&) = delete;
+    History &operator=(History &&) = delete;
+
+    void setBudget(std::size_t bytes);
+    void setCompression(bool enabled);
+
+    // forgets everything and starts over from `data`
+    void reset(const std::vector<RGBA> &data, int width, int height);
+
+    // marks pixels in [x0, x1) x [y0, y1) as changed since the last commit
+    void markDirty(int x0, int y0, int x1, int y1);
+    void markAllDirty();
+
+    // records `data` as a new step, copying only the dirty tiles. Returns
+    // false (and records nothing) if nothing was marked dirty.
+    bool commit(const std::vector<RGBA> &data, int width, int height);
+
+    bool canUndo() const;
+    bool canRedo() const;
+    // write the previous/next step into `data`; the size may change
+    bool undo(std::vector<RGBA> &data, int &width, int &height);
+    bool redo(std::vector<RGBA> &data, int &width, int &height);
+
+    int steps() const;
+    // bytes held by all tiles of all steps (shared tiles are counted once)
+    std::size_t memoryUsage() const;
+
+private:
+    struct Tile {
+        std::vector<RGBA> pixels;
+        QByteArray compressed;
+        std::size_t *usage;
+
+        explicit Tile(std::size_t *usage) : usage(usage) {}
+        ~Tile() { *usage -= bytes(); }
+        std::size_t bytes() const { return pixels.size() * sizeof(RGBA) + compressed.size(); }
+    };
+
+    struct Step {
+        int width = 0;
+        int height = 0;
+        std::vector<std::shared_ptr<Tile>> tiles;
+    };
+
+    int tilesX(int width) const { return (width + TILE - 1) / TILE; }
+    int tilesY(int height) const { return (height + TILE - 1) / TILE; }
+
+    std::shared_ptr<Tile> copyTile(const std::vector<RGBA> &data, int width, int height, int tx, int ty);
+    void restoreTile(const Tile &tile, std::vector<RGBA> &data, int width, int height, int tx, int ty) const;
+    void restore(const Step &from, const Step &to, std::vector<RGBA> &data, int &width, int &height);
+    void compressStep(int index);
+    void enforceBudget();
+
+    // declared before m_steps so it outlives the tiles that update it
+    std::size_t m_usage = 0;
+    std::size_t m_budget;
+    bool m_compression = false;
+
+    std::vector<Step> m_steps;   // oldest first
+    int m_current = -1;          // step that matches the canvas
+    std::vector<bool> m_dirty;   // per tile of the current step
+};
+
+#endif // HISTORY_H
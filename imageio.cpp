@@ -0,0 +1,71 @@
+#include "imageio.h"
+#include <QFile>
+#include <QImage>
+#include <QImageReader>
+#include <algorithm>
+
+namespace {
+
+// a file that tells how much of it the image decoder has read so far
+class ProgressFile : public QFile {
+public:
+    ProgressFile(const QString &name, const std::function<void(int)> &progress)
+        : QFile(name), m_progress(progress) {}
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override {
+        qint64 n = QFile::readData(data, maxSize);
+        if (m_progress && n > 0 && size() > 0) {
+            m_read += n;
+            int percent = int(std::min<qint64>(100, 100 * m_read / size()));
+            if (percent != m_percent) {
+                m_percent = percent;
+                m_progress(percent);
+            }
+        }
+        return n;
+    }
+
+private:
+    const std::function<void(int)> &m_progress;
+    qint64 m_read = 0;
+    int m_percent = -1;
+};
+
+} // namespace
+
+/**
+ * @brief Stores the image specified from the input file in `data`
+ * @param file: file path to an image
+ * @return True if successfully loads image, False otherwise.
+ */
+bool loadImage(const QString &file, std::vector<RGBA> &data, int &width, int &height,
+               const std::function<void(int)> &progress) {
+    ProgressFile device(file, progress);
+    if (!device.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QImageReader reader(&device);
+    QImage myImage;
+    if (!reader.read(&myImage)) {
+        return false;
+    }
+    // in place for the usual 32-bit decoder output, no second image
+    myImage.convertTo(QImage::Format_RGBX8888);
+    width = myImage.width();
+    height = myImage.height();
+
+    // rows of a 32-bit QImage are never padded, so this is one bulk copy
+    const RGBA *pixels = reinterpret_cast<const RGBA*>(myImage.constBits());
+    data.assign(pixels, pixels + size_t(width) * height);
+    return true;
+}
+
+/**
+ * @brief Writes `data` to `file`
+ * @return True if the image was written, False otherwise.
+ */
+bool saveImage(const QString &file, const std::vector<RGBA> &data, int width, int height) {
+    QImage image(reinterpret_cast<const uchar*>(data.data()), width, height, 4*width, QImage::Format_RGBX8888);
+    return image.save(file);
+}
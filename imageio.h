@@ -0,0 +1,19 @@
+#ifndef IMAGEIO_H
+#define IMAGEIO_H
+
+#include <QString>
+#include <functional>
+#include <vector>
+#include "rgba.h"
+
+// Decodes an image file into an RGBA buffer. Only needs QtGui, so it can be
+// used without a QApplication (e.g. from the batch tool's worker threads).
+// `progress`, if set, is called with the percentage of the file read so far
+// whenever it changes, on the thread doing the decoding.
+bool loadImage(const QString &file, std::vector<RGBA> &data, int &width, int &height,
+               const std::function<void(int)> &progress = {});
+
+// Encodes an RGBA buffer to disk; the format is picked from the file suffix.
+bool saveImage(const QString &file, const std::vector<RGBA> &data, int width, int height);
+
+#endif // IMAGEIO_H
@@ -9,6 +9,7 @@
 #include <QTabWidget>
 #include <QScrollArea>
 #include <QCheckBox>
+#include <algorithm>
 #include <iostream>
 
 MainWindow::MainWindow()
@@ -56,6 +57,17 @@ MainWindow::MainWindow()
 
     vLayout->addWidget(controlsScroll);
 
+    // shown while an image is decoded in the background
+    m_loadProgress = new QProgressBar();
+    m_loadProgress->setFormat("Loading image... %p%");
+    m_loadProgress->hide();
+    vLayout->addWidget(m_loadProgress);
+    connect(m_canvas, &Canvas2D::loadProgress, this, [this](int percent) {
+        m_loadProgress->setValue(percent);
+        m_loadProgress->show();
+    });
+    connect(m_canvas, &Canvas2D::loadFinished, m_loadProgress, &QProgressBar::hide);
+
     // brush selection
     addHeading(brushLayout, "Brush");
     addRadioButton(brushLayout, "Constant", settings.brushType == BRUSH_CONSTANT, [this]{ setBrushType(BRUSH_CONSTANT); });
@@ -74,8 +86,11 @@ MainWindow::MainWindow()
     addHeading(brushLayout, "Extra Credit Brushes");
     addRadioButton(brushLayout, "Spray", settings.brushType == BRUSH_SPRAY, [this]{ setBrushType(BRUSH_SPRAY); });
     addSpinBox(brushLayout, "density", 1, 100, 1, settings.brushDensity, [this](int value){ setIntVal(settings.brushDensity, value); });
+    addDoubleSpinBox(brushLayout, "smudge pickup", 0, 1, 0.05, settings.smudgeStrength, 2, [this](float value){ setFloatVal(settings.smudgeStrength, value); });
     addRadioButton(brushLayout, "Speed", settings.brushType == BRUSH_SPEED, [this]{ setBrushType(BRUSH_SPEED); });
     addRadioButton(brushLayout, "Fill", settings.brushType == BRUSH_FILL, [this]{ setBrushType(BRUSH_FILL); });
+    addSpinBox(brushLayout, "fill tolerance", 0, 255, 1, settings.fillTolerance, [this](int value){ setIntVal(settings.fillTolerance, value); });
+    addCheckBox(brushLayout, "8-connected fill", settings.fillEightConnected, [this](bool value){ setBoolVal(settings.fillEightConnected, value); });
     addRadioButton(brushLayout, "Custom", settings.brushType == BRUSH_CUSTOM, [this]{ setBrushType(BRUSH_CUSTOM); });
     addCheckBox(brushLayout, "Fix alpha blending", settings.fixAlphaBlending, [this](bool value){ setBoolVal(settings.fixAlphaBlending, value); });
 
@@ -85,6 +100,9 @@ MainWindow::MainWindow()
     // my fun exploration
     addHeading(brushLayout, "My Fun Exploration");
     addPushButton(brushLayout, "Undo One Stroke", &MainWindow::onPrevButtonClick);
+    addPushButton(brushLayout, "Redo One Stroke", &MainWindow::onNextButtonClick);
+    addSpinBox(brushLayout, "history (MB)", 16, 4096, 16, settings.historyBudget, [this](int value){ setIntVal(settings.historyBudget, value); });
+    addCheckBox(brushLayout, "Compress old history", settings.historyCompression, [this](bool value){ setBoolVal(settings.historyCompression, value); });
     addRadioButton(brushLayout, "Eraser", settings.brushType == BRUSH_ERASER, [this]{ setBrushType(BRUSH_ERASER); });
 //    addRadioButton(brushLayout, "Color Picker", settings.brushType == BRUSH_COLOR_PICKER, [this]{ setBrushType(BRUSH_COLOR_PICKER); });
     addRadioButton(brushLayout, "Eraser Connected", settings.brushType == BRUSH_ERASER_CONNECTED, [this]{ setBrushType(BRUSH_ERASER_CONNECTED); });
@@ -93,6 +111,7 @@ MainWindow::MainWindow()
     addHeading(filterLayout, "Filter");
     addRadioButton(filterLayout, "Edge detect", settings.filterType == FILTER_EDGE_DETECT,  [this]{ setFilterType(FILTER_EDGE_DETECT); });
     addDoubleSpinBox(filterLayout, "sensitivity", 0.01, 1, 0.01, settings.edgeDetectSensitivity, 2, [this](float value){ setFloatVal(settings.edgeDetectSensitivity, value); });
+    addComboBox(filterLayout, "magnitude", {"exact", "|gx| + |gy|", "alpha max + beta min"}, settings.edgeMagnitude, [this](int value){ setIntVal(settings.edgeMagnitude, value); });
 
     addRadioButton(filterLayout, "Blur", settings.filterType == FILTER_BLUR, [this]{ setFilterType(FILTER_BLUR); });
     addSpinBox(filterLayout, "radius", 0, 100, 1, settings.blurRadius, [this](int value){ setIntVal(settings.blurRadius, value); });
@@ -114,16 +133,39 @@ MainWindow::MainWindow()
     addRadioButton(filterLayout, "Tone mapping", settings.filterType == FILTER_MAPPING,  [this]{ setFilterType(FILTER_MAPPING); });
     addCheckBox(filterLayout, "Non linear function", settings.nonLinearMap, [this](bool value){ setBoolVal(settings.nonLinearMap, value); });
     addDoubleSpinBox(filterLayout, "gamma", 0.1, 2, 0.1, settings.gamma, 2, [this](float value){ setFloatVal(settings.gamma, value); });
+    addDoubleSpinBox(filterLayout, "clip %", 0, 10, 0.1, settings.toneClip, 2, [this](float value){ setFloatVal(settings.toneClip, value); });
 
     addRadioButton(filterLayout, "Rotation", settings.filterType == FILTER_ROTATION,  [this]{ setFilterType(FILTER_ROTATION); });
     addDoubleSpinBox(filterLayout, "angle", -360, 360, 0.1, settings.rotationAngle, 2, [this](float value){ setFloatVal(settings.rotationAngle, value); });
 
     addRadioButton(filterLayout, "Bilteral smooth", settings.filterType == FILTER_BILATERAL,  [this]{ setFilterType(FILTER_BILATERAL); });
     addSpinBox(filterLayout, "radius", 1, 100, 1, settings.bilateralRadius, [this](int value){ setIntVal(settings.bilateralRadius, value); });
+    addCheckBox(filterLayout, "Fast approximation (grid)", settings.bilateralGrid, [this](bool value){ setBoolVal(settings.bilateralGrid, value); });
 
     // filter push buttons
     addPushButton(filterLayout, "Load Image", &MainWindow::onUploadButtonClick);
+    addCheckBox(filterLayout, "Live preview", settings.filterPreview, [this](bool value){ setBoolVal(settings.filterPreview, value); });
     addPushButton(filterLayout, "Apply Filter", &MainWindow::onFilterButtonClick);
+
+    // progress of the filter running in the background, with a way out
+    QWidget *filterStatus = new QWidget();
+    QHBoxLayout *filterStatusLayout = new QHBoxLayout();
+    filterStatusLayout->setContentsMargins(0, 0, 0, 0);
+    QProgressBar *filterProgress = new QProgressBar();
+    filterProgress->setFormat("Filtering... %p%");
+    QPushButton *cancelButton = new QPushButton("Cancel");
+    filterStatusLayout->addWidget(filterProgress, 1);
+    filterStatusLayout->addWidget(cancelButton);
+    filterStatus->setLayout(filterStatusLayout);
+    filterStatus->hide();
+    filterLayout->addWidget(filterStatus);
+    connect(cancelButton, &QPushButton::clicked, m_canvas, &Canvas2D::cancelFilter);
+    connect(m_canvas, &Canvas2D::filterProgress, this, [filterStatus, filterProgress](int percent) {
+        // passes of a filter are counted as they start, so never go backwards
+        filterProgress->setValue(percent == 0 ? 0 : std::max(percent, filterProgress->value()));
+        filterStatus->show();
+    });
+    connect(m_canvas, &Canvas2D::filterFinished, filterStatus, &QWidget::hide);
     addPushButton(filterLayout, "Revert Image", &MainWindow::onRevertButtonClick);
 }
 
@@ -207,6 +249,18 @@ void MainWindow::addCheckBox(QBoxLayout *layout, QString text, bool val, auto fu
     connect(box, &QCheckBox::clicked, this, function);
 }
 
+void MainWindow::addComboBox(QBoxLayout *layout, QString text, QStringList items, int index, auto function) {
+    QComboBox *box = new QComboBox();
+    box->addItems(items);
+    box->setCurrentIndex(index);
+    QHBoxLayout *subLayout = new QHBoxLayout();
+    addLabel(subLayout, text);
+    subLayout->addWidget(box);
+    layout->addLayout(subLayout);
+    connect(box, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+            this, function);
+}
+
 
 
 // ------ FUNCTIONS FOR UPDATING SETTINGS ------
@@ -253,12 +307,16 @@ void MainWindow::onPrevButtonClick() {
     m_canvas->prevCanvas();
 }
 
+void MainWindow::onNextButtonClick() {
+    m_canvas->nextCanvas();
+}
+
 void MainWindow::onFilterButtonClick() {
     m_canvas->filterImage();
 }
 
 void MainWindow::onRevertButtonClick() {
-    m_canvas->loadImageFromFile(settings.imagePath);
+    m_canvas->revertImage();
 }
 
 void MainWindow::onUploadButtonClick() {
@@ -6,9 +6,11 @@
 #include <QSpinBox>
 #include <QRadioButton>
 #include <QCheckBox>
+#include <QComboBox>
 #include <QDoubleSpinBox>
 #include <QLabel>
 #include <QPushButton>
+#include <QProgressBar>
 #include <QBoxLayout>
 
 #include "canvas2d.h"
@@ -23,6 +25,7 @@ public:
 private:
     void setupCanvas2D();
     Canvas2D *m_canvas;
+    QProgressBar *m_loadProgress;
 
     void addHeading(QBoxLayout *layout, QString text);
     void addLabel(QBoxLayout *layout, QString text);
@@ -31,6 +34,7 @@ private:
     void addDoubleSpinBox(QBoxLayout *layout, QString text, double min, double max, double step, double val, int decimal, auto function);
     void addPushButton(QBoxLayout *layout, QString text, auto function);
     void addCheckBox(QBoxLayout *layout, QString text, bool value, auto function);
+    void addComboBox(QBoxLayout *layout, QString text, QStringList items, int index, auto function);
 
 private slots:
     void setBrushType(int type);
@@ -43,6 +47,7 @@ private slots:
 
     void onClearButtonClick();
     void onPrevButtonClick();
+    void onNextButtonClick();
     void onFilterButtonClick();
     void onRevertButtonClick();
     void onUploadButtonClick();
@@ -0,0 +1,127 @@
+#include "median.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+// every histogram has 256 fine bins plus 16 coarse bins (one per 16 fine
+// bins), so finding the median scans at most 16 + 16 bins
+constexpr int FINE = 256;
+constexpr int COARSE = 16;
+constexpr int CHANNELS = 3;
+
+static_assert((2 * MAX_MEDIAN_RADIUS + 1) * (2 * MAX_MEDIAN_RADIUS + 1) <= 0xffff,
+              "median window too large for 16-bit counts");
+
+struct Histogram {
+    std::uint16_t fine[CHANNELS][FINE];
+    std::uint16_t coarse[CHANNELS][COARSE];
+};
+
+inline std::uint8_t channel(const RGBA &p, int c) {
+    return c == 0 ? p.r : (c == 1 ? p.g : p.b);
+}
+
+inline void addPixel(Histogram &h, const RGBA &p, int sign) {
+    for (int c = 0; c < CHANNELS; c++) {
+        std::uint8_t v = channel(p, c);
+        h.fine[c][v] += sign;
+        h.coarse[c][v >> 4] += sign;
+    }
+}
+
+// kernel += sign * column; written as flat loops so they vectorize
+inline void addHistogram(Histogram &kernel, const Histogram &column, int sign) {
+    std::uint16_t *dst = &kernel.fine[0][0];
+    const std::uint16_t *src = &column.fine[0][0];
+    constexpr int n = sizeof(Histogram) / sizeof(std::uint16_t);
+    if (sign > 0) {
+        for (int i = 0; i < n; i++) dst[i] += src[i];
+    } else {
+        for (int i = 0; i < n; i++) dst[i] -= src[i];
+    }
+}
+
+// value of the k-th smallest (0-based) entry of channel c
+inline std::uint8_t kthValue(const Histogram &h, int c, int k) {
+    int bin = 0;
+    while (bin < COARSE - 1 && k >= h.coarse[c][bin]) {
+        k -= h.coarse[c][bin];
+        bin++;
+    }
+    int value = bin * 16;
+    while (value < FINE - 1 && k >= h.fine[c][value]) {
+        k -= h.fine[c][value];
+        value++;
+    }
+    return value;
+}
+
+/**
+ * @brief Filters output rows [begin, end); all histograms are allocated once
+ * per band
+ */
+void medianBand(const std::vector<RGBA> &data, std::vector<RGBA> &result,
+                int width, int height, int radius, int begin, int end) {
+    std::vector<Histogram> columns(width, Histogram{});
+    Histogram kernel;
+
+    // column histograms for the window one row above the band, so the loop
+    // below can slide it onto `begin` like onto every other row
+    for (int row = std::max(0, begin - radius - 1); row <= std::min(height - 1, begin + radius - 1); row++) {
+        for (int col = 0; col < width; col++) {
+            addPixel(columns[col], data[size_t(row) * width + col], 1);
+        }
+    }
+
+    for (int row = begin; row < end; row++) {
+        // slide every column window down by one row
+        int removed = row - radius - 1;
+        int added = row + radius;
+        for (int col = 0; col < width; col++) {
+            if (removed >= 0) {
+                addPixel(columns[col], data[size_t(removed) * width + col], -1);
+            }
+            if (added < height) {
+                addPixel(columns[col], data[size_t(added) * width + col], 1);
+            }
+        }
+        int rows = std::min(height - 1, row + radius) - std::max(0, row - radius) + 1;
+
+        kernel = Histogram{};
+        for (int col = 0; col <= std::min(width - 1, radius); col++) {
+            addHistogram(kernel, columns[col], 1);
+        }
+        RGBA *dst = &result[size_t(row) * width];
+        for (int col = 0; col < width; col++) {
+            int cols = std::min(width - 1, col + radius) - std::max(0, col - radius) + 1;
+            int k = (rows * cols - 1) / 2;
+            dst[col] = RGBA{kthValue(kernel, 0, k), kthValue(kernel, 1, k), kthValue(kernel, 2, k), 255};
+
+            if (col + radius + 1 < width) {
+                addHistogram(kernel, columns[col + radius + 1], 1);
+            }
+            if (col - radius >= 0) {
+                addHistogram(kernel, columns[col - radius], -1);
+            }
+        }
+    }
+}
+
+} // namespace
+
+void medianFilter(const std::vector<RGBA> &data, int width, int height, int radius, std::vector<RGBA> &result) {
+    if (radius <= 0) {
+        result = data;
+        return;
+    }
+    radius = std::min(radius, MAX_MEDIAN_RADIUS);
+    result.resize(data.size());
+    // building the column histograms costs ~2r rows per band, so bands are
+    // kept at least that tall to keep the per-pixel cost independent of r
+    int band = std::max(32, 2 * radius + 1);
+    parallelFor(0, height, band, [&](int begin, int end) {
+        medianBand(data, result, width, height, radius, begin, end);
+    });
+}
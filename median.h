@@ -0,0 +1,27 @@
+#ifndef MEDIAN_H
+#define MEDIAN_H
+
+#include <vector>
+#include "rgba.h"
+
+/**
+ * @file    median.h
+ *
+ * Median filter for FILTER_MEDIAN using sliding histograms (Perreault &
+ * Hebert, "Median Filtering in Constant Time"). Every column keeps a
+ * histogram of the 2r+1 pixels above/below the current row; moving one
+ * pixel right adds one column histogram to the kernel histogram and removes
+ * another, so the cost per pixel does not depend on the radius.
+ *
+ * Pixels outside the image are left out of the window, like before, and
+ * the lower median is used when the window has an even number of pixels.
+ */
+
+// the histograms count in 16 bits, so the (2r+1)^2 window must stay below 65536
+constexpr int MAX_MEDIAN_RADIUS = 127;
+
+// writes the filtered image to `result` (resized to fit, must not be `data`).
+// `radius` is clamped to MAX_MEDIAN_RADIUS
+void medianFilter(const std::vector<RGBA> &data, int width, int height, int radius, std::vector<RGBA> &result);
+
+#endif // MEDIAN_H
@@ -0,0 +1,222 @@
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Job {
+    const std::function<void(int, int)> *body;
+    std::atomic<int> remaining;
+    JobControl *control;
+};
+
+struct Task {
+    Job *job;
+    int begin;
+    int end;
+};
+
+struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+};
+
+// queue owned by the current thread; external callers share queue 0
+thread_local int t_queue = 0;
+// job the current thread's parallelFor calls report to, if any
+thread_local JobControl *t_control = nullptr;
+
+// runs one chunk on behalf of `control` (if any), unless it has been
+// cancelled. A thread helping out may run chunks of other jobs, so the
+// control is switched to the chunk's own for any nested parallelFor
+void runChunk(JobControl *control, const std::function<void(int, int)> &body, int begin, int end) {
+    if (control && control->cancelled()) {
+        control->chunkDone();
+        return;
+    }
+    JobControl *previous = t_control;
+    t_control = control;
+    body(begin, end);
+    t_control = previous;
+    if (control) {
+        control->chunkDone();
+    }
+}
+
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads) {
+        for (int i = 0; i < threads; i++) {
+            m_queues.push_back(std::make_unique<WorkQueue>());
+        }
+        for (int i = 1; i < threads; i++) {
+            m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (auto &worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    int size() const {
+        return m_queues.size();
+    }
+
+    void run(int begin, int end, int grain, const std::function<void(int, int)> &body) {
+        int chunks = (end - begin + grain - 1) / grain;
+        Job job{&body, chunks, t_control};
+        if (job.control) {
+            job.control->addChunks(chunks);
+        }
+
+        // deal consecutive chunks to the queues round robin, so every
+        // thread starts on its own part of the image
+        int first = m_next_queue++;
+        for (int i = 0; i < chunks; i++) {
+            WorkQueue &queue = *m_queues[(first + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(Task{&job, begin + i * grain, std::min(end, begin + (i + 1) * grain)});
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_pending += chunks;
+        }
+        m_wake.notify_all();
+
+        // help out until our own chunks are finished; this may run chunks of
+        // other jobs too, which is what keeps nested calls from deadlocking
+        Task task;
+        while (job.remaining.load(std::memory_order_acquire) > 0) {
+            if (popTask(t_queue, task)) {
+                execute(task);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    // own queue from the back, other queues from the front
+    bool popTask(int home, Task &task) {
+        int count = m_queues.size();
+        for (int i = 0; i < count; i++) {
+            WorkQueue &queue = *m_queues[(home + i) % count];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            if (i == 0) {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            } else {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            }
+            m_pending--;
+            return true;
+        }
+        return false;
+    }
+
+    void execute(Task &task) {
+        runChunk(task.job->control, *task.job->body, task.begin, task.end);
+        task.job->remaining.fetch_sub(1, std::memory_order_release);
+    }
+
+    void workerLoop(int index) {
+        t_queue = index;
+        Task task;
+        while (true) {
+            if (popTask(index, task)) {
+                execute(task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+            m_wake.wait(lock, [this] { return m_stop || m_pending > 0; });
+            if (m_stop) {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::atomic<int> m_next_queue = 0;
+    std::atomic<int> m_pending = 0;
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+};
+
+int requested_threads = 0;
+std::unique_ptr<ThreadPool> pool;
+std::mutex pool_mutex;
+
+ThreadPool &threadPool() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (!pool) {
+        int threads = requested_threads > 0 ? requested_threads : std::thread::hardware_concurrency();
+        pool = std::make_unique<ThreadPool>(std::max(1, threads));
+    }
+    return *pool;
+}
+
+} // namespace
+
+void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body) {
+    grain = std::max(1, grain);
+    if (end <= begin) {
+        return;
+    }
+    ThreadPool &workers = threadPool();
+    if (workers.size() == 1 || end - begin <= grain) {
+        if (!t_control) {
+            body(begin, end);
+            return;
+        }
+        // still chunked, so a job on one thread can be cancelled
+        JobControl *control = t_control;
+        control->addChunks((end - begin + grain - 1) / grain);
+        for (int chunk = begin; chunk < end; chunk += grain) {
+            runChunk(control, body, chunk, std::min(end, chunk + grain));
+        }
+        return;
+    }
+    workers.run(begin, end, grain, body);
+}
+
+float JobControl::progress() const {
+    long long total = m_total;
+    return total > 0 ? std::min(1.f, float(m_done) / total) : 0.f;
+}
+
+JobScope::JobScope(JobControl *control) : m_previous(t_control) {
+    t_control = control;
+}
+
+JobScope::~JobScope() {
+    t_control = m_previous;
+}
+
+void setThreadCount(int threads) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    requested_threads = threads;
+    pool.reset();
+}
+
+int threadCount() {
+    return threadPool().size();
+}
@@ -0,0 +1,67 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <functional>
+
+/**
+ * @file    parallel.h
+ *
+ * A small work-stealing scheduler shared by the filters. `parallelFor`
+ * splits a range into chunks, deals them out to per-thread queues and lets
+ * idle threads steal from busy ones, so chunks of uneven cost (borders,
+ * reflected edges, large kernels) still keep every core busy. The calling
+ * thread works on the range too and returns once every chunk is done.
+ *
+ * The body must only write outputs that belong to its own chunk; then the
+ * result does not depend on the thread count or on which thread ran what.
+ */
+
+// calls body(chunk_begin, chunk_end) for consecutive chunks of at most
+// `grain` elements covering [begin, end)
+void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body);
+
+// number of threads used by parallelFor, including the caller.
+// 0 means one per hardware thread. Must not be changed while a
+// parallelFor is running.
+void setThreadCount(int threads);
+int threadCount();
+
+// Progress and cooperative cancellation for a long computation made of
+// parallelFor calls, e.g. a filter run in the background. While a JobScope
+// is active on a thread, every parallelFor it starts (and every parallelFor
+// nested in those) counts its chunks here, and once cancel() is called the
+// chunks that have not started yet are skipped. The computation then
+// returns early with a partial result, which the caller throws away.
+class JobControl {
+public:
+    void cancel() { m_cancelled = true; }
+    bool cancelled() const { return m_cancelled; }
+    // finished chunks out of all chunks started so far, in [0, 1]
+    float progress() const;
+
+    // bookkeeping done by parallelFor
+    void addChunks(int chunks) { m_total += chunks; }
+    void chunkDone() { m_done++; }
+
+private:
+    std::atomic<bool> m_cancelled = false;
+    std::atomic<long long> m_total = 0;
+    std::atomic<long long> m_done = 0;
+};
+
+// attaches `control` to the parallelFor calls made on this thread for the
+// lifetime of the scope
+class JobScope {
+public:
+    explicit JobScope(JobControl *control);
+    ~JobScope();
+
+    JobScope(const JobScope &) = delete;
+    JobScope &operator=(const JobScope &) = delete;
+
+private:
+    JobControl *m_previous;
+};
+
+#endif // PARALLEL_H
@@ -0,0 +1,51 @@
+#include "preview.h"
+#include "scale.h"
+#include <algorithm>
+#include <cmath>
+
+void ImagePyramid::build(const std::vector<RGBA> &data, int width, int height, int min_width, int min_height) {
+    m_levels.clear();
+    const std::vector<RGBA> *src = &data;
+    while ((width + 1) / 2 >= min_width && (height + 1) / 2 >= min_height && width > 1 && height > 1) {
+        Level level;
+        halveImage(*src, width, height, level.pixels);
+        width = level.width = (width + 1) / 2;
+        height = level.height = (height + 1) / 2;
+        m_levels.push_back(std::move(level));
+        src = &m_levels.back().pixels;
+    }
+}
+
+void ImagePyramid::clear() {
+    m_levels.clear();
+}
+
+/**
+ * @brief Scales the radii in `settings` to pyramid level `level`
+ */
+Settings proxySettings(const Settings &settings, int level) {
+    Settings proxy = settings;
+    float factor = 1.f / (1 << level);
+    auto scaleRadius = [factor](int radius, int min_radius) {
+        return radius <= 0 ? radius : std::max(min_radius, int(std::lround(radius * factor)));
+    };
+    proxy.blurRadius = scaleRadius(settings.blurRadius, 0);
+    proxy.medianRadius = scaleRadius(settings.medianRadius, 1);
+    proxy.bilateralRadius = scaleRadius(settings.bilateralRadius, 1);
+    // the chromatic aberration factor is 1 + lambda r^2 with r in pixels
+    float area = float(1 << level) * float(1 << level);
+    proxy.lambda_1 = settings.lambda_1 * area;
+    proxy.lambda_2 = settings.lambda_2 * area;
+    proxy.lambda_3 = settings.lambda_3 * area;
+    return proxy;
+}
+
+bool sameFilterSettings(const Settings &a, const Settings &b) {
+    return a.filterPreview == b.filterPreview && a.filterType == b.filterType
+        && a.edgeDetectSensitivity == b.edgeDetectSensitivity && a.edgeMagnitude == b.edgeMagnitude
+        && a.blurRadius == b.blurRadius && a.scaleX == b.scaleX && a.scaleY == b.scaleY
+        && a.medianRadius == b.medianRadius && a.rotationAngle == b.rotationAngle
+        && a.bilateralRadius == b.bilateralRadius && a.bilateralGrid == b.bilateralGrid
+        && a.lambda_1 == b.lambda_1 && a.lambda_2 == b.lambda_2 && a.lambda_3 == b.lambda_3
+        && a.nonLinearMap == b.nonLinearMap && a.gamma == b.gamma && a.toneClip == b.toneClip;
+}
@@ -0,0 +1,50 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include <vector>
+#include "rgba.h"
+#include "settings.h"
+
+/**
+ * @file    preview.h
+ *
+ * Low-resolution proxies for live filter previews. ImagePyramid keeps 2x2
+ * box halvings of the canvas image, built once per edit, and the preview
+ * runs the selected filter on the smallest level that still covers the
+ * view. proxySettings rescales the parameters measured in pixels so the
+ * result looks like the full-resolution filter, only softer.
+ */
+
+class ImagePyramid {
+public:
+    // halves `data` until the next level would be smaller than
+    // min_width x min_height; level 0 is `data` itself and is not stored
+    void build(const std::vector<RGBA> &data, int width, int height, int min_width, int min_height);
+    void clear();
+    bool empty() const { return m_levels.empty(); }
+
+    // the deepest level, 0 if the image is already no larger than the minimum
+    int levels() const { return int(m_levels.size()); }
+    // level k >= 1; level k is about 1 / 2^k the size of level 0
+    const std::vector<RGBA> &pixels(int k) const { return m_levels[k - 1].pixels; }
+    int width(int k) const { return m_levels[k - 1].width; }
+    int height(int k) const { return m_levels[k - 1].height; }
+
+private:
+    struct Level {
+        std::vector<RGBA> pixels;
+        int width;
+        int height;
+    };
+    std::vector<Level> m_levels;
+};
+
+// whether the selected filter (and the preview switch) are the same in both,
+// i.e. whether a preview made with `a` still shows `b`
+bool sameFilterSettings(const Settings &a, const Settings &b);
+
+// `settings` with the pixel-sized filter parameters (radii) divided by 2^level,
+// and the chromatic aberration lambdas (per pixel squared) multiplied by 4^level
+Settings proxySettings(const Settings &settings, int level);
+
+#endif // PREVIEW_H
@@ -0,0 +1,225 @@
+#include "rotate.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr int BLOCK = 64;
+constexpr double FIXED_ONE = 4294967296.0; // 2^32
+constexpr RGBA BACKGROUND = RGBA{255, 255, 255, 255};
+
+// the angle as cos/sin (exact for multiples of 90 degrees) and the centers
+// of the source and output images
+struct Rotation {
+    int quarter = -1; // 0..3 for multiples of 90 degrees, -1 otherwise
+    double c = 1;
+    double s = 0;
+    double cx, cy;   // source center
+    double ocx, ocy; // output center
+
+    Rotation(int width, int height, float degrees) {
+        double a = std::fmod(double(degrees), 360.0);
+        if (a < 0) {
+            a += 360;
+        }
+        long q = std::lround(a / 90);
+        if (std::fabs(a - 90.0 * q) < 1e-4) {
+            quarter = int(q % 4);
+            static constexpr int cosines[] = {1, 0, -1, 0};
+            static constexpr int sines[] = {0, 1, 0, -1};
+            c = cosines[quarter];
+            s = sines[quarter];
+        } else {
+            double radians = a * M_PI / 180;
+            c = std::cos(radians);
+            s = std::sin(radians);
+        }
+        cx = width / 2.0;
+        cy = height / 2.0;
+    }
+
+    void setOutput(int output_width, int output_height) {
+        ocx = output_width / 2.0;
+        ocy = output_height / 2.0;
+    }
+
+    // source pixel coordinates of output pixel (ox, oy). With y pointing down,
+    // a counterclockwise turn maps (x, y) to (x c + y s, -x s + y c) about the
+    // centers; this is its inverse, on pixel centers
+    void source(double ox, double oy, double &sx, double &sy) const {
+        double dx = ox + 0.5 - ocx;
+        double dy = oy + 0.5 - ocy;
+        sx = cx + dx * c - dy * s - 0.5;
+        sy = cy + dx * s + dy * c - 0.5;
+    }
+};
+
+#if defined(__SSE2__)
+inline __m128 toFloat4(RGBA p) {
+    std::uint32_t bits = p.r | p.g << 8 | p.b << 16 | std::uint32_t(p.a) << 24;
+    __m128i zero = _mm_setzero_si128();
+    __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(int(bits)), zero);
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+}
+#endif
+
+// bilinear blend of the four pixels around a sample, fx/fy in [0, 1)
+inline RGBA bilinear(RGBA p00, RGBA p10, RGBA p01, RGBA p11, float fx, float fy) {
+    float w00 = (1 - fx) * (1 - fy);
+    float w10 = fx * (1 - fy);
+    float w01 = (1 - fx) * fy;
+    float w11 = fx * fy;
+#if defined(__SSE2__)
+    __m128 acc = _mm_mul_ps(_mm_set1_ps(w00), toFloat4(p00));
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w10), toFloat4(p10)));
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w01), toFloat4(p01)));
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w11), toFloat4(p11)));
+    __m128i v = _mm_cvttps_epi32(_mm_add_ps(acc, _mm_set1_ps(0.5f)));
+    v = _mm_packs_epi32(v, v);
+    v = _mm_packus_epi16(v, v);
+    std::uint32_t bits = std::uint32_t(_mm_cvtsi128_si32(v));
+    return RGBA{std::uint8_t(bits), std::uint8_t(bits >> 8), std::uint8_t(bits >> 16), std::uint8_t(bits >> 24)};
+#else
+    auto blend = [&](std::uint8_t a, std::uint8_t b, std::uint8_t c, std::uint8_t d) {
+        return std::uint8_t(w00 * a + w10 * b + w01 * c + w11 * d + 0.5f);
+    };
+    return RGBA{blend(p00.r, p10.r, p01.r, p11.r), blend(p00.g, p10.g, p01.g, p11.g),
+                blend(p00.b, p10.b, p01.b, p11.b), blend(p00.a, p10.a, p01.a, p11.a)};
+#endif
+}
+
+} // namespace
+
+void rotatedSize(int width, int height, float degrees, int &output_width, int &output_height) {
+    Rotation rotation(width, height, degrees);
+    if (rotation.quarter == 1 || rotation.quarter == 3) {
+        output_width = height;
+        output_height = width;
+    } else if (rotation.quarter >= 0) {
+        output_width = width;
+        output_height = height;
+    } else {
+        // the small slack keeps float error from adding a column of background
+        double ac = std::fabs(rotation.c);
+        double as = std::fabs(rotation.s);
+        output_width = std::max(1, int(std::ceil(width * ac + height * as - 1e-3)));
+        output_height = std::max(1, int(std::ceil(width * as + height * ac - 1e-3)));
+    }
+}
+
+void rotateImage(const std::vector<RGBA> &data, int width, int height, float degrees, std::vector<RGBA> &result) {
+    int output_width, output_height;
+    rotatedSize(width, height, degrees, output_width, output_height);
+    rotateImageRect(data, 0, 0, width, height, width, height, degrees, 0, 0, output_width, output_height, result);
+}
+
+void rotateSourceRect(int width, int height, float degrees, int x, int y, int w, int h,
+                      int &src_x, int &src_y, int &src_w, int &src_h) {
+    int output_width, output_height;
+    rotatedSize(width, height, degrees, output_width, output_height);
+    Rotation rotation(width, height, degrees);
+    rotation.setOutput(output_width, output_height);
+
+    // the rotated rectangle is bounded by its corners; bilinear sampling
+    // reads one pixel further right and down, plus one pixel of slack
+    double min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    for (int corner = 0; corner < 4; corner++) {
+        double sx, sy;
+        rotation.source(x + (corner & 1) * (w - 1), y + (corner >> 1) * (h - 1), sx, sy);
+        min_x = std::min(min_x, sx);
+        min_y = std::min(min_y, sy);
+        max_x = std::max(max_x, sx);
+        max_y = std::max(max_y, sy);
+    }
+    int x0 = std::max(0, int(std::floor(min_x)) - 1);
+    int y0 = std::max(0, int(std::floor(min_y)) - 1);
+    int x1 = std::min(width, int(std::floor(max_x)) + 3);
+    int y1 = std::min(height, int(std::floor(max_y)) + 3);
+    src_x = x0;
+    src_y = y0;
+    src_w = std::max(0, x1 - x0);
+    src_h = std::max(0, y1 - y0);
+    if (src_w == 0 || src_h == 0) {
+        src_w = src_h = 0;
+    }
+}
+
+void rotateImageRect(const std::vector<RGBA> &rect, int src_x, int src_y, int src_w, int src_h,
+                     int width, int height, float degrees, int x, int y, int w, int h,
+                     std::vector<RGBA> &result) {
+    int output_width, output_height;
+    rotatedSize(width, height, degrees, output_width, output_height);
+    Rotation rotation(width, height, degrees);
+    rotation.setOutput(output_width, output_height);
+    result.resize(size_t(w) * h);
+
+    // pixels outside `rect` are outside the image (the rectangle covers every
+    // pixel inside it the output reads), so they read as background
+    auto pixel = [&](int ix, int iy) {
+        if (ix < 0 || iy < 0 || ix >= src_w || iy >= src_h) {
+            return BACKGROUND;
+        }
+        return rect[size_t(iy) * src_w + ix];
+    };
+
+    int blocks_x = (w + BLOCK - 1) / BLOCK;
+    int blocks_y = (h + BLOCK - 1) / BLOCK;
+    parallelFor(0, blocks_y, 1, [&](int begin, int end) {
+        for (int by = begin; by < end; by++) {
+            for (int bx = 0; bx < blocks_x; bx++) {
+                int ox_end = std::min(w, (bx + 1) * BLOCK);
+                int oy_end = std::min(h, (by + 1) * BLOCK);
+                for (int oy = by * BLOCK; oy < oy_end; oy++) {
+                    RGBA *out = &result[size_t(oy) * w];
+                    int ox = bx * BLOCK;
+                    if (rotation.quarter >= 0) {
+                        // exact: every output pixel is one source pixel, and
+                        // each step right moves by (c, s) in the source
+                        double sx, sy;
+                        rotation.source(x + ox, y + oy, sx, sy);
+                        int ix = int(std::lround(sx)) - src_x;
+                        int iy = int(std::lround(sy)) - src_y;
+                        int step = int(rotation.c) + int(rotation.s) * src_w;
+                        const RGBA *in = &rect[size_t(iy) * src_w + ix];
+                        for (; ox < ox_end; ox++, in += step) {
+                            out[ox] = *in;
+                        }
+                        continue;
+                    }
+
+                    // 32.32 fixed point, stepped from output column 0 of the
+                    // row so every tile computes the same positions
+                    double row_x, row_y;
+                    rotation.source(0, y + oy, row_x, row_y);
+                    long long px0 = std::llround(row_x * FIXED_ONE) - ((long long)src_x << 32);
+                    long long py0 = std::llround(row_y * FIXED_ONE) - ((long long)src_y << 32);
+                    long long dx = std::llround(rotation.c * FIXED_ONE);
+                    long long dy = std::llround(rotation.s * FIXED_ONE);
+                    for (; ox < ox_end; ox++) {
+                        long long px = px0 + (x + ox) * dx;
+                        long long py = py0 + (x + ox) * dy;
+                        int ix = int(px >> 32);
+                        int iy = int(py >> 32);
+                        float fx = float(std::uint32_t(px)) * (1.f / FIXED_ONE);
+                        float fy = float(std::uint32_t(py)) * (1.f / FIXED_ONE);
+                        if (ix >= 0 && iy >= 0 && ix + 1 < src_w && iy + 1 < src_h) {
+                            const RGBA *p = &rect[size_t(iy) * src_w + ix];
+                            out[ox] = bilinear(p[0], p[1], p[src_w], p[src_w + 1], fx, fy);
+                        } else if (ix < -1 || iy < -1 || ix >= src_w || iy >= src_h) {
+                            out[ox] = BACKGROUND;
+                        } else {
+                            // the image border blends into the background
+                            out[ox] = bilinear(pixel(ix, iy), pixel(ix + 1, iy),
+                                               pixel(ix, iy + 1), pixel(ix + 1, iy + 1), fx, fy);
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
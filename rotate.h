@@ -0,0 +1,36 @@
+#ifndef ROTATE_H
+#define ROTATE_H
+
+#include <vector>
+#include "rgba.h"
+
+/**
+ * @file    rotate.h
+ *
+ * Rotation used by FILTER_ROTATION. The output is the bounding box of the
+ * rotated image, filled with white outside of it. Multiples of 90 degrees
+ * are exact pixel moves; any other angle samples the source bilinearly at
+ * the inverse-rotated position of each output pixel (SSE2 float4 per pixel,
+ * scalar fallback). Either way the output is walked in 64 x 64 blocks, so
+ * the source pixels a block reads (a rotated 64 x 64 square) stay in cache
+ * instead of each output row sweeping a diagonal through the whole source.
+ */
+
+// size of the bounding box of a width x height image rotated by `degrees`
+void rotatedSize(int width, int height, float degrees, int &output_width, int &output_height);
+
+// rotates `data` by `degrees` counterclockwise (as displayed) about its center.
+// The result is rotatedSize() pixels and goes to `result` (must not be `data`)
+void rotateImage(const std::vector<RGBA> &data, int width, int height, float degrees, std::vector<RGBA> &result);
+
+// the same rotation for the output rectangle (x, y, w, h) only, for images
+// processed in tiles. rotateSourceRect gives the source rectangle those
+// output pixels read (clipped to the image, possibly empty); rotateImageRect
+// takes exactly that rectangle in `rect` and writes w x h pixels to `result`
+void rotateSourceRect(int width, int height, float degrees, int x, int y, int w, int h,
+                      int &src_x, int &src_y, int &src_w, int &src_h);
+void rotateImageRect(const std::vector<RGBA> &rect, int src_x, int src_y, int src_w, int src_h,
+                     int width, int height, float degrees, int x, int y, int w, int h,
+                     std::vector<RGBA> &result);
+
+#endif // ROTATE_H
@@ -0,0 +1,246 @@
+#include "scale.h"
+#include "blur.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// first source index and normalized weights for each output index
+struct ScaleTable {
+    int taps = 0;
+    std::vector<int> first;
+    std::vector<float> weights; // `taps` per output index, zero padded
+};
+
+float triangle(float x, float a) {
+    float r = a < 1 ? 1.0 / a : 1.0;
+    if ((x < -r) || (x > r)) {
+        return 0.0;
+    } else {
+        return (1.0 - fabs(x) / r) / r;
+    }
+}
+
+ScaleTable buildTable(float scale, int input, int output) {
+    ScaleTable table;
+    float support = (scale > 1.0) ? 1.0 : 1.0 / scale;
+    table.taps = int(std::floor(2 * support)) + 2;
+    table.first.resize(output);
+    table.weights.assign(size_t(output) * table.taps, 0.f);
+
+    for (int o = 0; o < output; o++) {
+        float center = o / scale + (1 - scale) / (2 * scale);
+        int left = std::max(0, int(std::ceil(center - support)));
+        int right = std::min(input - 1, int(std::floor(center + support)));
+        right = std::min(right, left + table.taps - 1);
+        float *w = &table.weights[size_t(o) * table.taps];
+        float sum = 0.f;
+        for (int idx = left; idx <= right; idx++) {
+            w[idx - left] = triangle(idx - center, scale);
+            sum += w[idx - left];
+        }
+        // taps outside the image are dropped and the rest renormalized
+        for (int t = 0; t < table.taps && sum > 0.f; t++) {
+            w[t] /= sum;
+        }
+        // keep every tap inside the image so the passes need no bounds checks
+        table.first[o] = std::clamp(left, 0, std::max(0, input - table.taps));
+        if (table.first[o] != left) {
+            std::rotate(w, w + table.taps - (left - table.first[o]), w + table.taps);
+        }
+    }
+    return table;
+}
+
+// 2:1 box filter along x (the last pixel of an odd row is averaged with itself)
+std::vector<RGBA> halveX(const std::vector<RGBA> &data, int width, int height) {
+    int out = (width + 1) / 2;
+    std::vector<RGBA> result(size_t(out) * height);
+    parallelFor(0, height, 16, [&](int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            const RGBA *src = &data[size_t(y) * width];
+            RGBA *dst = &result[size_t(y) * out];
+            for (int x = 0; x < out; x++) {
+                const RGBA &a = src[2*x];
+                const RGBA &b = src[std::min(2*x + 1, width - 1)];
+                dst[x] = RGBA{std::uint8_t((a.r + b.r + 1) >> 1), std::uint8_t((a.g + b.g + 1) >> 1),
+                              std::uint8_t((a.b + b.b + 1) >> 1), std::uint8_t((a.a + b.a + 1) >> 1)};
+            }
+        }
+    });
+    return result;
+}
+
+// 2:1 box filter along y, a byte-wise average of row pairs
+std::vector<RGBA> halveY(const std::vector<RGBA> &data, int width, int height) {
+    int out = (height + 1) / 2;
+    std::vector<RGBA> result(size_t(width) * out);
+    parallelFor(0, out, 16, [&](int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            const std::uint8_t *a = reinterpret_cast<const std::uint8_t*>(&data[size_t(2*y) * width]);
+            const std::uint8_t *b = reinterpret_cast<const std::uint8_t*>(&data[size_t(std::min(2*y + 1, height - 1)) * width]);
+            std::uint8_t *dst = reinterpret_cast<std::uint8_t*>(&result[size_t(y) * width]);
+            int n = 4 * width;
+            int i = 0;
+#if defined(__SSE2__)
+            for (; i + 16 <= n; i += 16) {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_avg_epu8(va, vb));
+            }
+#endif
+            for (; i < n; i++) {
+                dst[i] = (a[i] + b[i] + 1) >> 1;
+            }
+        }
+    });
+    return result;
+}
+
+std::uint8_t toUint8(float x) {
+    return std::clamp(x, 0.f, 255.f) + 0.5f;
+}
+
+} // namespace
+
+void halveImage(const std::vector<RGBA> &data, int width, int height, std::vector<RGBA> &result) {
+    result = halveY(halveX(data, width, height), (width + 1) / 2, height);
+}
+
+void scaleSourceRows(int height, float scaleY, int output_height, int out_begin, int out_end,
+                     int &src_begin, int &src_end) {
+    // same mipmap levels as scaleImageRows
+    int levels = 0;
+    int level_height = height;
+    while (scaleY < 0.5f && level_height > 1) {
+        level_height = (level_height + 1) / 2;
+        scaleY *= 2;
+        levels++;
+    }
+    ScaleTable ty = buildTable(scaleY, level_height, output_height);
+    int taps_y = std::min(ty.taps, level_height);
+    // first[] never decreases, so the first and last output row bound the window
+    src_begin = ty.first[out_begin] << levels;
+    src_end = std::min(height, (ty.first[out_end - 1] + taps_y) << levels);
+}
+
+void scaleImage(const std::vector<RGBA> &data, int width, int height,
+                float scaleX, float scaleY, int output_width, int output_height, std::vector<RGBA> &result) {
+    scaleImageRows(data, width, height, 0, scaleX, scaleY, output_width, output_height, 0, output_height, result);
+}
+
+void scaleImageRows(const std::vector<RGBA> &rows, int width, int height, int src_begin,
+                    float scaleX, float scaleY, int output_width, int output_height,
+                    int out_begin, int out_end, std::vector<RGBA> &result) {
+    int window = width > 0 ? int(rows.size() / width) : 0;
+    if (output_width <= 0 || out_end <= out_begin || width <= 0 || window <= 0) {
+        result.clear();
+        return;
+    }
+
+    // mipmap: every halving doubles the remaining scale and keeps pixel centers
+    // where the triangle filter expects them. The window starts on a multiple
+    // of 2^levels and holds whole row pairs, so it halves like the full image
+    std::vector<RGBA> level;
+    const std::vector<RGBA> *src = &rows;
+    while (scaleX < 0.5f && width > 1) {
+        level = halveX(*src, width, window);
+        src = &level;
+        width = (width + 1) / 2;
+        scaleX *= 2;
+    }
+    while (scaleY < 0.5f && height > 1) {
+        level = halveY(*src, width, window);
+        src = &level;
+        window = (window + 1) / 2;
+        height = (height + 1) / 2;
+        src_begin /= 2;
+        scaleY *= 2;
+    }
+
+    ScaleTable tx = buildTable(scaleX, width, output_width);
+    ScaleTable ty = buildTable(scaleY, height, output_height);
+    int taps_x = std::min(tx.taps, width);
+    int taps_y = std::min(ty.taps, height);
+    int line = 4 * output_width;
+
+    // output rows go in bands, each keeping the last taps_y horizontally
+    // filtered rows in a ring, so no full-size float intermediate is made.
+    // Every band primes its ring with up to taps_y rows, so use as few bands
+    // as keep the threads busy (two each, for stealing)
+    int output_rows = out_end - out_begin;
+    int band = std::max(16, (output_rows + 2*threadCount() - 1) / (2*threadCount()));
+    int bands = (output_rows + band - 1) / band;
+    result.resize(size_t(output_width) * output_rows);
+
+    parallelFor(0, bands, 1, [&](int first_band, int last_band) {
+        std::vector<float> row(4 * width);
+        std::vector<float> ring(size_t(line) * taps_y);
+        std::vector<float> acc(line);
+
+        // horizontal pass of window row y into its ring slot: each output
+        // pixel is a weighted sum of float4 pixels
+        auto horizontal = [&](int y) -> float * {
+            return &ring[size_t(y % taps_y) * line];
+        };
+        auto filterRow = [&](int y) {
+            const RGBA *in = &(*src)[size_t(y) * width];
+            for (int x = 0; x < width; x++) {
+                row[4*x] = in[x].r;
+                row[4*x+1] = in[x].g;
+                row[4*x+2] = in[x].b;
+                row[4*x+3] = 0;
+            }
+            float *out = horizontal(y);
+            for (int o = 0; o < output_width; o++) {
+                const float *p = &row[4 * tx.first[o]];
+                const float *w = &tx.weights[size_t(o) * tx.taps];
+#if defined(__SSE2__)
+                __m128 acc4 = _mm_setzero_ps();
+                for (int t = 0; t < taps_x; t++) {
+                    acc4 = _mm_add_ps(acc4, _mm_mul_ps(_mm_set1_ps(w[t]), _mm_loadu_ps(p + 4*t)));
+                }
+                _mm_storeu_ps(out + 4*o, acc4);
+#else
+                float acc4[4] = {0, 0, 0, 0};
+                for (int t = 0; t < taps_x; t++) {
+                    for (int c = 0; c < 4; c++) {
+                        acc4[c] += w[t] * p[4*t + c];
+                    }
+                }
+                std::copy(acc4, acc4 + 4, out + 4*o);
+#endif
+            }
+        };
+
+        for (int b = first_band; b < last_band; b++) {
+            int begin = out_begin + b * band;
+            int end = std::min(out_end, begin + band);
+            // vertical pass: first[] never decreases, so the rows an output
+            // row reads only move down and each enters the ring once
+            int next = ty.first[begin] - src_begin;
+            for (int o = begin; o < end; o++) {
+                int first = ty.first[o] - src_begin;
+                for (next = std::max(next, first); next < first + taps_y; next++) {
+                    filterRow(next);
+                }
+                std::fill(acc.begin(), acc.end(), 0.f);
+                const float *w = &ty.weights[size_t(o) * ty.taps];
+                for (int t = 0; t < taps_y; t++) {
+                    if (w[t] != 0.f) {
+                        addScaled(acc.data(), horizontal(first + t), w[t], line);
+                    }
+                }
+                RGBA *dst = &result[size_t(o - out_begin) * output_width];
+                for (int x = 0; x < output_width; x++) {
+                    dst[x] = RGBA{toUint8(acc[4*x]), toUint8(acc[4*x+1]), toUint8(acc[4*x+2]), 255};
+                }
+            }
+        }
+    });
+}
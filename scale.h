@@ -0,0 +1,41 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <vector>
+#include "rgba.h"
+
+/**
+ * @file    scale.h
+ *
+ * Resampling used by FILTER_SCALE: a separable triangle filter whose support
+ * grows to 1/scale when shrinking. The taps and normalized weights of every
+ * output column and row are computed once up front, so the passes are plain
+ * weighted sums; the horizontal pass adds whole pixels as float4 and the
+ * vertical pass adds whole rows. Output rows go in bands that keep only the
+ * horizontal rows they still read in a small ring, so there is no full-size
+ * float intermediate. Shrinking below 1/2 first halves the image
+ * with 2:1 box filters (a mipmap level per halving) so the triangle filter
+ * never needs more than a few taps.
+ */
+
+// resizes `data` to output_width x output_height. Output pixel o is centered
+// on source position (o + 0.5) / scale - 0.5 along each axis. The result goes
+// to `result` (resized to fit, must not be `data`)
+void scaleImage(const std::vector<RGBA> &data, int width, int height,
+                float scaleX, float scaleY, int output_width, int output_height, std::vector<RGBA> &result);
+
+// 2x2 box filter, (width + 1) / 2 x (height + 1) / 2 pixels; the same
+// halving scaleImage uses for its mipmap levels
+void halveImage(const std::vector<RGBA> &data, int width, int height, std::vector<RGBA> &result);
+
+// the same resampling for output rows [out_begin, out_end) only, for images
+// processed in bands. scaleSourceRows gives the source rows [src_begin, src_end)
+// those output rows read; scaleImageRows takes exactly these rows (full width)
+// in `rows` and writes output_width x (out_end - out_begin) pixels to `result`
+void scaleSourceRows(int height, float scaleY, int output_height, int out_begin, int out_end,
+                     int &src_begin, int &src_end);
+void scaleImageRows(const std::vector<RGBA> &rows, int width, int height, int src_begin,
+                    float scaleX, float scaleY, int output_width, int output_height,
+                    int out_begin, int out_end, std::vector<RGBA> &result);
+
+#endif // SCALE_H
@@ -31,54 +31,84 @@ void Settings::loadSettingsOrDefaults() {
     brushColor.b = s.value("brushBlue", 0).toInt();
     brushColor.a = s.value("brushAlpha", 255).toInt();
     brushDensity = s.value("brushDensity", 5).toInt();
+    smudgeStrength = s.value("smudgeStrength", 1.0).toDouble();
     fixAlphaBlending = s.value("fixAlphaBlending", false).toBool();
+    fillTolerance = s.value("fillTolerance", 0).toInt();
+    fillEightConnected = s.value("fillEightConnected", false).toBool();
+    historyBudget = s.value("historyBudget", 256).toInt();
+    historyCompression = s.value("historyCompression", false).toBool();
 
     filterType = s.value("filterType", FILTER_EDGE_DETECT).toInt();
     edgeDetectSensitivity = s.value("edgeDetectSensitivity", 0.5f).toDouble();
+    edgeMagnitude = s.value("edgeMagnitude", 0).toInt();
     blurRadius = s.value("blurRadius", 10).toInt();
     scaleX = s.value("scaleX", 2).toDouble();
     scaleY = s.value("scaleY", 2).toDouble();
     medianRadius = s.value("medianRadius", 1).toInt();
     rotationAngle = s.value("rotationAngle", 90.0).toFloat();
-    bilateralRadius = s.value("bilateral radius", 1).toInt();
+    bilateralRadius = s.value("bilateralRadius", 1).toInt();
+    bilateralGrid = s.value("bilateralGrid", false).toBool();
     lambda_1 = s.value("lambda 1", 1e-7).toFloat();
-    lambda_2 = s.value("lambda 1", 5e-7).toFloat();
-    lambda_3 = s.value("lambda 1", 1e-6).toFloat();
+    lambda_2 = s.value("lambda 2", 5e-7).toFloat();
+    lambda_3 = s.value("lambda 3", 1e-6).toFloat();
     nonLinearMap = s.value("nonLinearMap", false).toBool();
     gamma = s.value("gamma", 0.1).toFloat();
+    toneClip = s.value("toneClip", 0).toFloat();
+    filterPreview = s.value("filterPreview", false).toBool();
 
     imagePath = s.value("imagePath", "").toString();
 }
 
+/**
+ * @brief The settings saved between sessions, by key
+ */
+QVariantMap Settings::values() const {
+    QVariantMap v;
+
+    v["brushType"] = brushType;
+    v["brushRadius"] = brushRadius;
+    v["brushRed"] = brushColor.r;
+    v["brushGreen"] = brushColor.g;
+    v["brushBlue"] = brushColor.b;
+    v["brushAlpha"] = brushColor.a;
+    v["brushDensity"] = brushDensity;
+    v["smudgeStrength"] = smudgeStrength;
+    v["fixAlphaBlending"] = fixAlphaBlending;
+    v["fillTolerance"] = fillTolerance;
+    v["fillEightConnected"] = fillEightConnected;
+    v["historyBudget"] = historyBudget;
+    v["historyCompression"] = historyCompression;
+
+    v["filterType"] = filterType;
+    v["edgeDetectSensitivity"] = edgeDetectSensitivity;
+    v["edgeMagnitude"] = edgeMagnitude;
+    v["blurRadius"] = blurRadius;
+    v["scaleX"] = scaleX;
+    v["scaleY"] = scaleY;
+    v["medianRadius"] = medianRadius;
+    v["rotationAngle"] = rotationAngle;
+    v["bilateralRadius"] = bilateralRadius;
+    v["bilateralGrid"] = bilateralGrid;
+    v["lambda 1"] = lambda_1;
+    v["lambda 2"] = lambda_2;
+    v["lambda 3"] = lambda_3;
+    v["nonLinearMap"] = nonLinearMap;
+    v["gamma"] = gamma;
+    v["toneClip"] = toneClip;
+    v["filterPreview"] = filterPreview;
+
+    v["imagePath"] = imagePath;
+    return v;
+}
+
 /**
  * @brief Saves settings from this session to be loaded
  * in for next session.
  */
 void Settings::saveSettings() {
     QSettings s("CS123", "CS123");
-
-    s.setValue("brushType", brushType);
-    s.setValue("brushRadius", brushRadius);
-    s.setValue("brushRed", brushColor.r);
-    s.setValue("brushGreen", brushColor.g);
-    s.setValue("brushBlue", brushColor.b);
-    s.setValue("brushAlpha", brushColor.a);
-    s.setValue("brushDensity", brushDensity);
-    s.setValue("fixAlphaBlending", fixAlphaBlending);
-
-    s.setValue("filterType", filterType);
-    s.setValue("edgeDetectSensitivity", edgeDetectSensitivity);
-    s.setValue("blurRadius", blurRadius);
-    s.setValue("scaleX", scaleX);
-    s.setValue("scaleY", scaleY);
-    s.setValue("medianRadius", medianRadius);
-    s.setValue("rotationAngle", rotationAngle);
-    s.setValue("bilateralRadius", bilateralRadius);
-    s.setValue("lambda 1", lambda_1);
-    s.setValue("lambda 2", lambda_2);
-    s.setValue("lambda 3", lambda_3);
-    s.setValue("nonLinearMap", nonLinearMap);
-    s.setValue("gamma", gamma);
-
-    s.setValue("imagePath", imagePath);
+    const QVariantMap v = values();
+    for (auto it = v.cbegin(); it != v.cend(); ++it) {
+        s.setValue(it.key(), it.value());
+    }
 }
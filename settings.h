@@ -9,6 +9,7 @@
 #define SETTINGS_H
 
 #include <QObject>
+#include <QVariantMap>
 #include "rgba.h"
 
 // Enumeration values for the Brush types from which the user can choose in the GUI.
@@ -56,27 +57,37 @@ struct Settings {
     int brushRadius;    // The brush radius
     RGBA brushColor;
     int brushDensity; // This is for spray brush (extra credit)
+    float smudgeStrength; // How much of the canvas the smudge picks up per stamp, 0 to 1
     bool fixAlphaBlending; // Fix alpha blending (extra credit)
+    int fillTolerance;     // Max channel difference the fill bucket still treats as the same color
+    bool fillEightConnected; // Fill (and connected eraser) also spread across diagonals
+    int historyBudget;     // Memory for undo/redo history, in MB
+    bool historyCompression; // Compress old undo/redo steps
 
     // Filter
     int filterType;                     // The selected filter @see FilterType
     float edgeDetectSensitivity;    // Edge detection sensitivity, from 0 to 1.
+    int edgeMagnitude;              // Gradient magnitude formula @see EdgeMagnitude
     int blurRadius;                 // Selected blur radius
     float scaleX;                   // Horizontal scale factor
     float scaleY;                   // Vertical scale factor
     int medianRadius;               // Median radius (extra credit)
     float rotationAngle;            // Rotation angle (extra credit)
     int bilateralRadius;            // Bilateral radius (extra credit)
+    bool bilateralGrid;             // Use the bilateral grid approximation instead of the exact filter
     float lambda_1;                 // Chromatic aberration labmda 1 (extra credit)
     float lambda_2;                 // Chromatic aberration labmda 2 (extra credit)
     float lambda_3;                 // Chromatic aberration labmda 3 (extra credit)
     bool nonLinearMap;              // Use non-linear mapping function for tone mapping (extra credit)
     float gamma;                    // Gamma for tone mapping (extra credit)
+    float toneClip;                 // Percent of values tone mapping clips at either end
+    bool filterPreview;             // Preview the selected filter live on a low-resolution proxy
 
     QString imagePath;
 
     void loadSettingsOrDefaults();
     void saveSettings();
+    QVariantMap values() const;
 };
 
 // The global Settings object, will be initialized by MainWindow
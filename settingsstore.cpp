@@ -0,0 +1,58 @@
+#include "settingsstore.h"
+#include <QSettings>
+
+SettingsStore::SettingsStore(const Settings &current) : m_saved(current.values()) {
+    // one writer thread, so flushes reach the disk in order
+    m_writer.setMaxThreadCount(1);
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(FLUSH_DELAY_MS);
+    QObject::connect(&m_timer, &QTimer::timeout, [this] { writeBehind(); });
+}
+
+SettingsStore::~SettingsStore() {
+    flush();
+}
+
+/**
+ * @brief Marks the settings that differ from the last recorded values dirty
+ * and (re)starts the flush timer
+ */
+void SettingsStore::changed(const Settings &current) {
+    const QVariantMap v = current.values();
+    for (auto it = v.cbegin(); it != v.cend(); ++it) {
+        if (m_saved.value(it.key()) != it.value()) {
+            m_saved[it.key()] = it.value();
+            m_dirty[it.key()] = it.value();
+        }
+    }
+    if (!m_dirty.isEmpty()) {
+        m_timer.start();
+    }
+}
+
+/**
+ * @brief Writes the dirty settings on the writer thread
+ */
+void SettingsStore::writeBehind() {
+    if (m_dirty.isEmpty()) {
+        return;
+    }
+    QVariantMap dirty;
+    dirty.swap(m_dirty);
+    m_writer.start([dirty] {
+        QSettings s("CS123", "CS123");
+        for (auto it = dirty.cbegin(); it != dirty.cend(); ++it) {
+            s.setValue(it.key(), it.value());
+        }
+        s.sync();
+    });
+}
+
+/**
+ * @brief Writes everything still pending and waits until it is on disk
+ */
+void SettingsStore::flush() {
+    m_timer.stop();
+    writeBehind();
+    m_writer.waitForDone();
+}
@@ -0,0 +1,41 @@
+#ifndef SETTINGSSTORE_H
+#define SETTINGSSTORE_H
+
+#include <QThreadPool>
+#include <QTimer>
+#include <QVariantMap>
+#include "settings.h"
+
+/**
+ * @brief Persists settings behind the UI.
+ *
+ * changed() only compares the settings with the values it recorded last and
+ * marks the keys that differ dirty. Once no change has come in for
+ * FLUSH_DELAY_MS, the dirty keys are written by a background thread, so a
+ * held spinbox arrow costs one write instead of one per step. flush(), also
+ * run on destruction, writes whatever is still pending and waits for it.
+ */
+class SettingsStore {
+public:
+    static constexpr int FLUSH_DELAY_MS = 500;
+
+    // `current` is taken to be what is on disk already
+    explicit SettingsStore(const Settings &current);
+    ~SettingsStore();
+
+    SettingsStore(const SettingsStore &) = delete;
+    SettingsStore &operator=(const SettingsStore &) = delete;
+
+    void changed(const Settings &current);
+    void flush();
+
+private:
+    void writeBehind();
+
+    QVariantMap m_saved;  // the values as of the last change
+    QVariantMap m_dirty;  // keys changed since the last write
+    QTimer m_timer;
+    QThreadPool m_writer;
+};
+
+#endif // SETTINGSSTORE_H
@@ -0,0 +1,49 @@
+#include "stroke.h"
+#include <algorithm>
+#include <cmath>
+
+void Stroke::begin(float x, float y, float spacing) {
+    m_last = {x, y};
+    m_spacing = std::max(spacing, 1.f);
+    m_travelled = 0.f;
+    m_pending.clear();
+}
+
+void Stroke::moveTo(float x, float y) {
+    float dx = x - m_last.x;
+    float dy = y - m_last.y;
+    float length = std::hypot(dx, dy);
+    if (length == 0.f) {
+        return;
+    }
+
+    // distance along this segment of the next stamp
+    float d = m_spacing - m_travelled;
+    while (d <= length) {
+        float t = d / length;
+        m_pending.push_back({m_last.x + t * dx, m_last.y + t * dy});
+        d += m_spacing;
+    }
+    m_travelled = length - (d - m_spacing);
+    m_last = {x, y};
+}
+
+std::size_t Stroke::rasterize(std::size_t max_stamps, const std::function<void(int, int)> &stamp) {
+    std::size_t count = std::min(max_stamps, m_pending.size());
+    for (std::size_t i = 0; i < count; i++) {
+        Point p = m_pending.front();
+        m_pending.pop_front();
+        stamp(int(std::lround(p.x)), int(std::lround(p.y)));
+    }
+    return count;
+}
+
+void Stroke::clear() {
+    m_pending.clear();
+    m_travelled = 0.f;
+}
+
+float Stroke::spacingFor(int radius) {
+    // a quarter of the radius keeps overlapping stamps visually continuous
+    return std::max(1.f, radius / 4.f);
+}
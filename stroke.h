@@ -0,0 +1,45 @@
+#ifndef STROKE_H
+#define STROKE_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+
+/**
+ * @brief Turns the pointer samples of one stroke into evenly spaced stamp
+ * positions.
+ *
+ * Samples are joined by straight segments and a stamp center is queued
+ * every `spacing` pixels along them, carrying the leftover distance from one
+ * segment to the next. Fast strokes get no gaps, slow ones do not pile up
+ * stamps on the same spot. Queued stamps are drawn later by `rasterize`,
+ * which the canvas calls once per display frame with a bounded batch size.
+ */
+class Stroke {
+public:
+    // starts a stroke at (x, y); the caller stamps this first point itself
+    void begin(float x, float y, float spacing);
+    // adds a pointer sample and queues the stamps on the way to it
+    void moveTo(float x, float y);
+    // calls `stamp(x, y)` for up to `max_stamps` queued centers, oldest first,
+    // and returns how many were drawn
+    std::size_t rasterize(std::size_t max_stamps, const std::function<void(int, int)> &stamp);
+    std::size_t pending() const { return m_pending.size(); }
+    void clear();
+
+    // distance between stamps for a brush of the given radius
+    static float spacingFor(int radius);
+
+private:
+    struct Point {
+        float x;
+        float y;
+    };
+
+    Point m_last{0.f, 0.f};
+    float m_spacing = 1.f;
+    float m_travelled = 0.f; // path length since the last queued stamp
+    std::deque<Point> m_pending;
+};
+
+#endif // STROKE_H
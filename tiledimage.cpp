@@ -0,0 +1,115 @@
+#include "tiledimage.h"
+#include <QDir>
+#include <QImage>
+#include <QImageReader>
+#include <QTemporaryFile>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+// rows converted at a time when an image has to be copied into the mapping
+static constexpr int COPY_ROWS = 256;
+
+TiledImage::TiledImage(const QString &scratchDir)
+    : m_scratchDir(scratchDir.isEmpty() ? QDir::tempPath() : scratchDir) {
+}
+
+TiledImage::~TiledImage() = default;
+
+/**
+ * @brief Creates and maps a scratch file big enough for width x height pixels
+ */
+bool TiledImage::allocate(int width, int height) {
+    m_file.reset();
+    m_pixels = nullptr;
+    m_width = m_height = 0;
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+
+    qint64 bytes = qint64(width) * height * qint64(sizeof(RGBA));
+    auto file = std::make_unique<QTemporaryFile>(QDir(m_scratchDir).filePath("projects_2d_XXXXXX.tiles"));
+    if (!file->open() || !file->resize(bytes)) {
+        return false;
+    }
+    uchar *pixels = file->map(0, bytes);
+    if (!pixels) {
+        return false;
+    }
+    m_file = std::move(file);
+    m_pixels = reinterpret_cast<RGBA*>(pixels);
+    m_width = width;
+    m_height = height;
+    return true;
+}
+
+/**
+ * @brief Decodes `file` into the mapping, converted to RGBX like loadImage does
+ */
+bool TiledImage::load(const QString &file) {
+    QImageReader reader(file);
+    QSize size = reader.size();
+    if (!size.isValid() || !allocate(size.width(), size.height())) {
+        return false;
+    }
+
+    // decoders that are handed an image of the right size and format fill
+    // it in place, here that is the mapping itself
+    QImage::Format format = reader.imageFormat();
+    QImage image;
+    if (QImage::toPixelFormat(format).bitsPerPixel() == 32) {
+        image = QImage(reinterpret_cast<uchar*>(m_pixels), m_width, m_height, 4*m_width, format);
+    }
+    if (!reader.read(&image) || image.size() != size) {
+        return false;
+    }
+
+    // convert a band at a time; in place when the decoder wrote into the mapping
+    for (int y = 0; y < m_height; y += COPY_ROWS) {
+        int rows = std::min(COPY_ROWS, m_height - y);
+        QImage band(image.constScanLine(y), m_width, rows, image.bytesPerLine(), image.format());
+        if (image.colorCount() > 0) {
+            band.setColorTable(image.colorTable());
+        }
+        band = band.convertToFormat(QImage::Format_RGBX8888);
+        if (band.constBits() == reinterpret_cast<const uchar*>(row(y))) {
+            continue; // already RGBX, decoded in place
+        }
+        for (int r = 0; r < rows; r++) {
+            std::memcpy(row(y + r), band.constScanLine(r), 4*size_t(m_width));
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Encodes the image straight from the mapping
+ */
+bool TiledImage::save(const QString &file) const {
+    if (!m_pixels) {
+        return false;
+    }
+    QImage image(reinterpret_cast<const uchar*>(m_pixels), m_width, m_height, 4*m_width, QImage::Format_RGBX8888);
+    return image.save(file);
+}
+
+void TiledImage::read(int x, int y, int w, int h, std::vector<RGBA> &out) const {
+    out.resize(size_t(w) * h);
+    for (int r = 0; r < h; r++) {
+        std::memcpy(&out[size_t(r) * w], row(y + r) + x, w * sizeof(RGBA));
+    }
+}
+
+void TiledImage::write(int x, int y, int w, int h, const RGBA *src, int stride) {
+    for (int r = 0; r < h; r++) {
+        std::memcpy(row(y + r) + x, src + size_t(r) * stride, w * sizeof(RGBA));
+    }
+}
+
+void TiledImage::swap(TiledImage &other) {
+    std::swap(m_scratchDir, other.m_scratchDir);
+    std::swap(m_file, other.m_file);
+    std::swap(m_pixels, other.m_pixels);
+    std::swap(m_width, other.m_width);
+    std::swap(m_height, other.m_height);
+}
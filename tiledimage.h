@@ -0,0 +1,67 @@
+#ifndef TILEDIMAGE_H
+#define TILEDIMAGE_H
+
+#include <QString>
+#include <memory>
+#include <vector>
+#include "rgba.h"
+
+class QTemporaryFile;
+
+/**
+ * @brief An RGBA image kept in a memory-mapped scratch file instead of RAM.
+ *
+ * Pixels are stored row-major in a temporary file that is mapped into the
+ * address space, so the kernel pages them in and out as needed and only the
+ * pages being touched count against memory. Filters work on it one
+ * TILE x TILE rectangle at a time (see FilterGraph::runTiled): a tile plus
+ * its halo is copied out into an ordinary buffer, filtered there, and its
+ * interior is written to a second TiledImage.
+ *
+ * load() decodes straight into the mapping when the image decoder can
+ * write into a caller-provided 32-bit image; otherwise the decoded image is
+ * copied in band by band and released. save() encodes from the mapping
+ * without copying it.
+ */
+class TiledImage {
+public:
+    static constexpr int TILE = 1024;
+
+    // scratch files go to `scratchDir` (the system temp directory if empty)
+    explicit TiledImage(const QString &scratchDir = QString());
+    ~TiledImage();
+
+    TiledImage(const TiledImage &) = delete;
+    TiledImage &operator=(const TiledImage &) = delete;
+
+    // a new, uninitialized width x height image; false if the scratch file
+    // cannot be created or mapped
+    bool allocate(int width, int height);
+
+    bool load(const QString &file);
+    bool save(const QString &file) const;
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    const QString &scratchDir() const { return m_scratchDir; }
+
+    RGBA *row(int y) { return m_pixels + size_t(y) * m_width; }
+    const RGBA *row(int y) const { return m_pixels + size_t(y) * m_width; }
+
+    // copies the w x h rectangle at (x, y) into `out`, tightly packed
+    void read(int x, int y, int w, int h, std::vector<RGBA> &out) const;
+    // copies a w x h rectangle from `src` (`stride` pixels per row) to (x, y)
+    void write(int x, int y, int w, int h, const RGBA *src, int stride);
+
+    // exchanges the contents (and scratch files) of two images
+    void swap(TiledImage &other);
+
+private:
+    QString m_scratchDir;
+    std::unique_ptr<QTemporaryFile> m_file;
+    RGBA *m_pixels = nullptr;
+    int m_width = 0;
+    int m_height = 0;
+};
+
+#endif // TILEDIMAGE_H
@@ -0,0 +1,85 @@
+#include "tonemap.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+void channelHistogram(const RGBA *pixels, std::size_t count, ToneHistogram &histogram) {
+    // a few parts per thread so uneven threads still balance out; each
+    // part counts into its own histogram
+    constexpr std::size_t MIN_PART = 1 << 16;
+    int parts = int(std::min<std::size_t>(4 * threadCount(), count / MIN_PART + 1));
+    std::vector<ToneHistogram> partial(parts);
+    parallelFor(0, parts, 1, [&](int begin, int end) {
+        for (int part = begin; part < end; part++) {
+            ToneHistogram &h = partial[part];
+            for (auto &channel : h) {
+                channel.fill(0);
+            }
+            std::size_t first = count * part / parts;
+            std::size_t last = count * (part + 1) / parts;
+            for (std::size_t i = first; i < last; i++) {
+                h[0][pixels[i].r]++;
+                h[1][pixels[i].g]++;
+                h[2][pixels[i].b]++;
+            }
+        }
+    });
+
+    for (auto &channel : histogram) {
+        channel.fill(0);
+    }
+    for (const ToneHistogram &h : partial) {
+        for (int c = 0; c < 3; c++) {
+            for (int v = 0; v < 256; v++) {
+                histogram[c][v] += h[c][v];
+            }
+        }
+    }
+}
+
+void toneCurves(const ToneHistogram &histogram, float clip, bool nonLinear, float gamma, ToneCurves &curves) {
+    // the three channels counted together
+    std::array<std::uint64_t, 256> counts = {};
+    std::uint64_t total = 0;
+    for (const auto &channel : histogram) {
+        for (int v = 0; v < 256; v++) {
+            counts[v] += channel[v];
+            total += channel[v];
+        }
+    }
+
+    // lo is the first value with more than `cut` values at or below it, hi
+    // the last with more than `cut` at or above it
+    std::uint64_t cut = std::uint64_t(double(total) * std::clamp(clip, 0.f, 0.4999f));
+    int lo = 0;
+    std::uint64_t below = counts[0];
+    while (lo < 255 && below <= cut) {
+        below += counts[++lo];
+    }
+    int hi = 255;
+    std::uint64_t above = counts[255];
+    while (hi > 0 && above <= cut) {
+        above += counts[--hi];
+    }
+
+    // a gamma of zero or below has no curve on [0, 1] (t^gamma is infinite
+    // at 0), so it and a non-finite one map linearly
+    if (!(gamma > 0) || !std::isfinite(gamma)) {
+        nonLinear = false;
+    }
+
+    for (auto &lut : curves) {
+        for (int v = 0; v < 256; v++) {
+            if (hi <= lo) {
+                lut[v] = v;
+                continue;
+            }
+            float t = std::clamp(float(v - lo) / (hi - lo), 0.f, 1.f);
+            if (nonLinear) {
+                t = std::pow(t, gamma);
+            }
+            lut[v] = std::uint8_t(std::lround(255 * t));
+        }
+    }
+}
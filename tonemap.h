@@ -0,0 +1,36 @@
+#ifndef TONEMAP_H
+#define TONEMAP_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "rgba.h"
+
+/**
+ * @file    tonemap.h
+ *
+ * Tone mapping used by FILTER_MAPPING, in two steps. channelHistogram
+ * counts the values of each channel in one parallel pass: every part of the
+ * image gets its own histogram and the parts are added up afterwards, so
+ * threads never share a counter. toneCurves then finds the range to stretch
+ * from the counts, leaving out a given fraction of the values at either end
+ * so a few stray pixels don't pin it, and turns it into one 256-entry table
+ * per channel, mapped to 0..255 linearly or through t^gamma. Applying the
+ * tables is a per-pixel lookup (FilterGraph runs it with its curves stages),
+ * so the curve is evaluated 256 times instead of once per pixel.
+ */
+
+using ToneHistogram = std::array<std::array<std::uint64_t, 256>, 3>;
+using ToneCurves = std::array<std::array<std::uint8_t, 256>, 3>;
+
+// counts the r, g and b values of `count` pixels into `histogram`
+void channelHistogram(const RGBA *pixels, std::size_t count, ToneHistogram &histogram);
+
+// maps [lo, hi] of all three channels together (so colors keep their
+// balance) to [0, 255]: linearly, or as 255 t^gamma when `nonLinear`. lo and
+// hi leave out the fraction `clip` (0 to < 0.5) of the values at each end;
+// 0 takes the minimum and maximum. A range of a single value is left as it
+// is, and a gamma that is not finite and > 0 maps linearly
+void toneCurves(const ToneHistogram &histogram, float clip, bool nonLinear, float gamma, ToneCurves &curves);
+
+#endif // TONEMAP_H